@@ -49,7 +49,7 @@ bool validate_message(HParseResult *p, void* user_data) {
 ///
 
 // Helper: Parse and pack the RDATA field of a Resource Record.
-void set_rdata(struct dns_rr *rr, HCountedArray *rdata) {
+void set_rdata(const HParseResult *parent, struct dns_rr *rr, HCountedArray *rdata) {
   uint8_t *data = h_arena_malloc(rdata->arena, sizeof(uint8_t)*rdata->used);
   for (size_t i=0; i<rdata->used; ++i)
     data[i] = H_CAST_UINT(rdata->elements[i]);
@@ -58,7 +58,7 @@ void set_rdata(struct dns_rr *rr, HCountedArray *rdata) {
   const HParseResult *p = NULL;
   const HParser *parser = init_rdata(rr->type);
   if (parser)
-    p = h_parse(parser, (const uint8_t*)data, rdata->used);
+    p = h_parse_nested(parent, parser, (const uint8_t*)data, rdata->used);
 
   // If the RR doesn't parse, set its type to 0.
   if (!p) 
@@ -131,7 +131,7 @@ HParsedToken* act_rr(const HParseResult *p, void* user_data) {
   rr->rdlength = H_FIELD_SEQ(4)->used;
 
   // Parse and pack RDATA.
-  set_rdata(rr, H_FIELD_SEQ(4));
+  set_rdata(p, rr, H_FIELD_SEQ(4));
 
   return H_MAKE(dns_rr_t, rr);
 }
@@ -42,6 +42,8 @@ struct HArena_ {
   size_t block_size;
   size_t used;
   size_t wasted;
+  struct HArena_ *scratch;  // idle scratch arenas, see h_arena_scratch
+  struct HArena_ *next;     // in the list above
 };
 
 HArena *h_new_arena(HAllocator* mm__, size_t block_size) {
@@ -57,6 +59,8 @@ HArena *h_new_arena(HAllocator* mm__, size_t block_size) {
   ret->block_size = block_size;
   ret->used = 0;
   ret->mm__ = mm__;
+  ret->scratch = NULL;
+  ret->next = NULL;
   ret->wasted = sizeof(struct arena_link) + sizeof(struct HArena_) + block_size;
   return ret;
 }
@@ -100,6 +104,11 @@ void h_arena_free(HArena *arena, void* ptr) {
 
 void h_delete_arena(HArena *arena) {
   HAllocator *mm__ = arena->mm__;
+  while (arena->scratch) {
+    HArena *next = arena->scratch->next;
+    h_delete_arena(arena->scratch);
+    arena->scratch = next;
+  }
   struct arena_link *link = arena->head;
   while (link) {
     struct arena_link *next = link->next; 
@@ -112,6 +121,42 @@ void h_delete_arena(HArena *arena) {
   h_free(arena);
 }
 
+HAllocator *h_arena_allocator(HArena *arena) {
+  return arena->mm__;
+}
+
+// hand out an empty arena for temporary use while allocating in this one,
+// reusing one given back by h_arena_scratch_done if there is one. each
+// caller gets its own, so nested users cannot trample each other.
+HArena *h_arena_scratch(HArena *arena) {
+  HArena *scratch = arena->scratch;
+  if (!scratch)
+    return h_new_arena(arena->mm__, 0);
+  arena->scratch = scratch->next;
+  scratch->next = NULL;
+  return scratch;
+}
+
+// empty a scratch arena, keeping its first block, and put it back
+void h_arena_scratch_done(HArena *arena, HArena *scratch) {
+  HAllocator *mm__ = scratch->mm__;
+  struct arena_link *link = scratch->head->next;
+  while (link) {
+    struct arena_link *next = link->next;
+    h_free(link);
+    link = next;
+  }
+  struct arena_link *head = scratch->head;
+  memset(head->rest, 0, head->used);
+  head->next = NULL;
+  head->free += head->used;
+  head->used = 0;
+  scratch->used = 0;
+  scratch->wasted = sizeof(struct arena_link) + sizeof(struct HArena_) + head->free;
+  scratch->next = arena->scratch;
+  arena->scratch = scratch;
+}
+
 void h_allocator_stats(HArena *arena, HArenaStats *stats) {
   stats->used = arena->used;
   stats->wasted = arena->wasted;
@@ -71,6 +71,8 @@ static inline HCFChoice* h_cfstack_new_choice_raw(HAllocator *mm__, HCFStack *st
   ret->reshape = NULL;
   ret->action = NULL;
   ret->pred = NULL;
+  ret->prec = 0;
+  ret->capture = false;
   ret->type = ~0; // invalid type
   // Add it to the current sequence...
   if (stk__->count > 0) {
@@ -1,9 +1,8 @@
 #include <assert.h>
+#include <string.h>
+#include "../parsers/parser_internal.h"
 #include "lr.h"
 
-static bool glr_step(HParseResult **result, HSlist *engines,
-                     HLREngine *engine, const HLRAction *action);
-
 
 /* GLR compilation (LALR w/o failing on conflict) */
 
@@ -25,204 +24,491 @@ void h_glr_free(HParser *parser)
 }
 
 
-/* Merging engines (when they converge on the same state) */
+/* Shared packed parse forest
+ *
+ * Every symbol recognized during the parse is represented by one node of the
+ * forest, identified by the symbol and the input span it covers. Different
+ * derivations of the same node are kept as "packed" alternatives, each
+ * referring to the forest nodes of its right-hand side.
+ *
+ * The semantic value of a node is that of its first valid alternative. It is
+ * only computed once the parse is complete and only for the nodes of the
+ * winning derivation, so semantic actions never run on dead branches.
+ * Validations are the exception: they decide which stacks survive, so a node
+ * whose symbol has a predicate is evaluated (with its subtree) right away.
+ */
+
+typedef struct HGLRSymbol_ HGLRSymbol;
+
+typedef struct HGLRPacked_ {
+  const HLRAction *production;  // the reduction
+  HGLRSymbol **children;        // rhs (production.length elements)
+  struct HGLRPacked_ *next;
+} HGLRPacked;
+
+struct HGLRSymbol_ {
+  const HCFChoice *symbol;      // NULL for input tokens
+  size_t start;                 // level where the symbol's span starts
+  size_t end;                   // ...and where it ends
+  bool done;                    // value computed?
+  HParsedToken *value;          // semantic value
+  HGLRPacked *alts;             // alternative derivations, NULL for tokens
+  HGLRSymbol *next;             // next symbol ending at the same level
+};
 
-static HLREngine *lrengine_merge(HLREngine *old, HLREngine *new)
-{
-  HArena *arena = old->arena;
 
-  HLREngine *ret = h_arena_malloc(arena, sizeof(HLREngine));
+/* Graph-structured stack
+ *
+ * All stacks are kept in one graph. A node stands for a parser state at a
+ * given input position ("level"); its edges point down to the nodes
+ * below it and carry the forest node of the symbol in between. Stacks that
+ * reach the same state at the same position share that node, so the graph
+ * grows by at most one node per state per input position.
+ */
+
+typedef struct HGLRNode_ HGLRNode;
+
+typedef struct HGLREdge_ {
+  HGLRNode *to;
+  HGLRSymbol *sym;
+  size_t id;                    // serial number, for ordering edges
+  struct HGLREdge_ *next;
+} HGLREdge;
+
+struct HGLRNode_ {
+  size_t state;
+  size_t level;
+  HGLREdge *edges;
+  HGLRNode *next;               // next node on the same level
+};
 
-  assert(old->state == new->state);
-  assert(old->input.input == new->input.input);
+typedef struct {
+  HGLRNode *node;
+  const HLRAction *action;
+  const HGLREdge *via;          // reduce only along paths through this edge
+} HGLRReduction;
+
+typedef struct {
+  HGLRNode *node;
+  size_t nextstate;
+} HGLRShift;
+
+typedef struct {
+  const HLRTable *table;
+  HArena *arena;                // will hold the results
+  HArena *tarena;               // tmp, deleted after parse
+  HInputStream input;           // positioned at the current level
+  size_t base;                  // input index of level 0
+
+  size_t level;                 // current input position
+  HGLRNode *frontier;           // nodes of the current level
+  HGLRSymbol *symbols;          // forest nodes ending at the current level
+  bool epsedges;                // edges within the current level?
+  size_t nedges;                // edge ids handed out
+
+  HGLRNode **top;               // node by state...
+  size_t *stamp;                // ...valid if stamp equals level+1
+
+  HSlist *reductions;           // pending HGLRReductions
+  HSlist *shifts;               // pending HGLRShifts for the current level
+  HSlist *nextshifts;           // pending HGLRShifts for the next level
+
+  HGLRSymbol *accept;           // start symbol, once recognized
+} HGLRParse;
+
+static HGLRNode *gss_lookup(const HGLRParse *p, size_t state)
+{
+  if(p->stamp[state] == p->level + 1)
+    return p->top[state];
+  return NULL;
+}
 
-  *ret = *old;
-  ret->stack = h_slist_new(arena);
-  ret->merged[0] = old;
-  ret->merged[1] = new;
+static HGLRNode *gss_node(HGLRParse *p, size_t state)
+{
+  HGLRNode *v = h_arena_malloc(p->tarena, sizeof(HGLRNode));
+  v->state = state;
+  v->level = p->level;
+  v->edges = NULL;
+  v->next = p->frontier;
+  p->frontier = v;
+
+  p->top[state] = v;
+  p->stamp[state] = p->level + 1;
+  return v;
+}
 
-  return ret;
+static HGLREdge *gss_edge(HGLRParse *p, HGLRNode *v, HGLRNode *u,
+                          HGLRSymbol *sym)
+{
+  HGLREdge *e = h_arena_malloc(p->tarena, sizeof(HGLREdge));
+  e->to = u;
+  e->sym = sym;
+  e->id = p->nedges++;
+  e->next = v->edges;
+  v->edges = e;
+
+  if(u->level == p->level)
+    p->epsedges = true;
+  return e;
 }
 
-static HSlist *demerge_stack(HSlistNode *bottom, HSlist *stack)
+// schedule the actions of node v. with 'via' given, only reductions along
+// paths through that edge; otherwise the node is new and gets everything.
+static void act(HGLRParse *p, HGLRNode *v, const HLRAction *action,
+                const HGLREdge *via, bool fresh)
 {
-  HArena *arena = stack->arena;
-
-  HSlist *ret = h_slist_new(arena);
-
-  // copy the stack from the top
-  HSlistNode **y = &ret->head;
-  for(HSlistNode *x=stack->head; x; x=x->next) {
-    HSlistNode *node = h_arena_malloc(arena, sizeof(HSlistNode));
-    node->elem = x->elem;
-    node->next = NULL;
-    *y = node;
-    y = &node->next;
+  if(action->type == HLR_SHIFT) {
+    if(fresh) {
+      HGLRShift *s = h_arena_malloc(p->tarena, sizeof(HGLRShift));
+      s->node = v;
+      s->nextstate = action->nextstate;
+      h_slist_push(p->nextshifts, s);
+    }
+  } else {
+    assert(action->type == HLR_REDUCE);
+    size_t len = action->production.length;
+    if(len == 0 ? fresh : via != NULL) {
+      HGLRReduction *r = h_arena_malloc(p->tarena, sizeof(HGLRReduction));
+      r->node = v;
+      r->action = action;
+      r->via = len == 0 ? NULL : via;
+      h_slist_push(p->reductions, r);
+    }
   }
-  *y = bottom;  // attach the ancestor stack
+}
 
-  return ret;
+static void actor(HGLRParse *p, HGLRNode *v, const HGLREdge *via, bool fresh)
+{
+  const HLRAction *action = h_lrtable_action(p->table, v->state, &p->input);
+  if(action == NULL)
+    return;   // no handle recognizable in input, stack dies
+
+  if(action->type == HLR_CONFLICT) {
+    for(HSlistNode *x=action->branches->head; x; x=x->next)
+      act(p, v, x->elem, via, fresh);
+  } else {
+    act(p, v, action, via, fresh);
+  }
 }
 
-static inline HLREngine *respawn(HLREngine *eng, HSlist *stack)
+// reschedule reductions for paths through a new edge e
+static void edge_added(HGLRParse *p, HGLRNode *v, const HGLREdge *e)
 {
-  // NB: this can be a destructive update because an engine is not used for
-  // anything after it is merged.
-  eng->stack = demerge_stack(eng->stack->head, stack);
-  return eng;
+  if(p->epsedges) {
+    // the edge may be reachable from any node on this level
+    for(HGLRNode *x=p->frontier; x; x=x->next)
+      actor(p, x, e, false);
+  } else {
+    actor(p, v, e, false);
+  }
 }
 
-static HLREngine *
-demerge(HParseResult **result, HSlist *engines,
-        HLREngine *engine, const HLRAction *action, size_t depth)
+// compute the semantic value of a forest node from its first alternative.
+// the subtree is walked iteratively, it can be as deep as the input is long.
+// returns false if validation fails.
+static bool forest_value(HGLRParse *p, HGLRSymbol *root)
 {
-  // no-op on engines that are not merged
-  if(!engine->merged[0])
-    return engine;
-
-  HSlistNode *p = engine->stack->head;
-  for(size_t i=0; i<depth; i++) {
-    // if stack hits bottom, respawn ancestors
-    if(p == NULL) {
-      HLREngine *a = respawn(engine->merged[0], engine->stack);
-      HLREngine *b = respawn(engine->merged[1], engine->stack);
-
-      // continue demerge until final depth reached
-      a = demerge(result, engines, a, action, depth-i);
-      b = demerge(result, engines, b, action, depth-i);
-      
-      // step and stow one ancestor...
-      glr_step(result, engines, a, action);
-
-      // ...and return the other
-      return b;
+  HSlist *stack = h_slist_new(p->tarena);
+  h_slist_push(stack, root);
+
+  while(!h_slist_empty(stack)) {
+    HGLRSymbol *sym = stack->head->elem;
+    if(sym->done) {
+      h_slist_pop(stack);
+      continue;
     }
-    p = p->next;
+
+    // evaluate children first, unless the value is just the input covered
+    const HGLRPacked *alt = sym->alts;
+    size_t len = sym->symbol->capture ? 0 : alt->production->production.length;
+    bool ready = true;
+    for(size_t i=0; i<len; i++) {
+      if(!alt->children[i]->done) {
+        h_slist_push(stack, alt->children[i]);
+        ready = false;
+      }
+    }
+    if(!ready)
+      continue;
+    h_slist_pop(stack);
+
+    HCountedArray *seq = h_carray_new_sized(p->arena, len);
+    for(size_t i=0; i<len; i++)
+      seq->elements[i] = alt->children[i]->value;
+    seq->used = len;
+
+    // NB: nodes with validations are evaluated as they are created, so
+    // only the root can fail here.
+    if(!h_lr_reduce_value(p->arena, p->tarena, alt->production, seq,
+                          p->input.input, p->base + sym->start,
+                          p->base + sym->end, &sym->value))
+      return false;
+    sym->done = true;
   }
 
-  return engine;    // there is enough stack before the merge point
+  return true;
 }
 
+// find or create the forest node for a reduction; NULL if validation fails
+static HGLRSymbol *forest_symbol(HGLRParse *p, const HLRAction *action,
+                                 size_t start, HGLRSymbol **children)
+{
+  size_t len = action->production.length;
+  const HCFChoice *lhs = action->production.lhs;
+
+  HGLRPacked *alt = h_arena_malloc(p->tarena, sizeof(HGLRPacked));
+  alt->production = action;
+  alt->children = h_arena_malloc(p->tarena, len * sizeof(HGLRSymbol *));
+  memcpy(alt->children, children, len * sizeof(HGLRSymbol *));
+  alt->next = NULL;
+
+  HGLRSymbol *sym;
+  for(sym=p->symbols; sym; sym=sym->next) {
+    if(sym->symbol == lhs && sym->start == start) {
+      // another derivation of a known symbol; pack it
+      HGLRPacked **a;
+      for(a=&sym->alts; *a; a=&(*a)->next);
+      *a = alt;
+      return sym;
+    }
+  }
 
-/* Forking engines (on conflicts */
+  sym = h_arena_malloc(p->tarena, sizeof(HGLRSymbol));
+  sym->symbol = lhs;
+  sym->start = start;
+  sym->end = p->level;
+  sym->done = false;
+  sym->value = NULL;
+  sym->alts = alt;
 
-HLREngine *fork_engine(const HLREngine *engine)
-{
-  HLREngine *eng2 = h_arena_malloc(engine->tarena, sizeof(HLREngine));
-  eng2->table = engine->table;
-  eng2->state = engine->state;
-  eng2->input = engine->input;
-
-  // shallow-copy the stack
-  // this works because h_slist_push and h_slist_drop never modify
-  // the underlying structure of HSlistNodes, only the head pointer.
-  // in fact, this gives us prefix sharing for free.
-  eng2->stack = h_arena_malloc(engine->tarena, sizeof(HSlist));
-  *eng2->stack = *engine->stack;
-
-  eng2->arena = engine->arena;
-  eng2->tarena = engine->tarena;
-  return eng2;
+  // run validations now, everything else is deferred
+  if(lhs->pred && !forest_value(p, sym))
+    return NULL;
+
+  sym->next = p->symbols;
+  p->symbols = sym;
+  return sym;
 }
 
-static const HLRAction *
-handle_conflict(HParseResult **result, HSlist *engines,
-                const HLREngine *engine, const HSlist *branches)
+static void reducer(HGLRParse *p, HGLRNode *u, const HLRAction *action,
+                    HGLRSymbol **children)
 {
-  // there should be at least two conflicting actions
-  assert(branches->head);
-  assert(branches->head->next);     // this is just a consistency check
+  // there are only shifts on nonterminals, see h_lrengine_step
+  const HLRAction *shift = h_lrtable_goto(p->table, u->state, action);
+  if(shift == NULL)
+    return;
+  assert(shift->type == HLR_SHIFT);
+
+  HGLRSymbol *sym = forest_symbol(p, action, u->level, children);
+  if(sym == NULL)
+    return;   // validation failed
+
+  if(shift->nextstate == HLR_SUCCESS) {
+    assert(action->production.lhs == p->table->start);
+    p->accept = sym;
+    return;
+  }
 
-  // fork a new engine for all but the first action
-  for(HSlistNode *x=branches->head->next; x; x=x->next) {
-    HLRAction *act = x->elem; 
-    HLREngine *eng = fork_engine(engine);
+  HGLRNode *w = gss_lookup(p, shift->nextstate);
+  if(w) {
+    // the same state on the same level accepts the same symbol, so an edge
+    // to u already carries sym. the derivation has been packed above.
+    for(HGLREdge *e=w->edges; e; e=e->next)
+      if(e->to == u)
+        return;
+    edge_added(p, w, gss_edge(p, w, u, sym));
+  } else {
+    w = gss_node(p, shift->nextstate);
+    actor(p, w, gss_edge(p, w, u, sym), true);
+  }
+}
 
-    // perform one step and add to engines
-    glr_step(result, engines, eng, act);
-  } 
+// walk all paths of length k down from v whose newest edge is 'via'
+static void reduce_paths(HGLRParse *p, HGLRNode *v, const HLRAction *action,
+                         size_t k, HGLRSymbol **children,
+                         const HGLREdge *via, bool seen)
+{
+  if(k == 0) {
+    if(seen || via == NULL)
+      reducer(p, v, action, children);
+    return;
+  }
 
-  // return first action for use with original engine
-  return branches->head->elem;
+  for(HGLREdge *e=v->edges; e; e=e->next) {
+    if(via && e->id > via->id)
+      continue;   // path will be walked again for the newer edge
+    children[k-1] = e->sym;
+    reduce_paths(p, e->to, action, k-1, children, via, seen || e == via);
+  }
 }
 
+// read the next input token and advance to the next level
+static HGLRSymbol *next_level(HGLRParse *p)
+{
+  // all stacks shift the same token, share its forest node
+  HGLRSymbol *sym = h_arena_malloc(p->tarena, sizeof(HGLRSymbol));
+  sym->symbol = NULL;
+  sym->start = p->level;
+  sym->end = p->level + 1;
+  sym->done = true;
+  sym->value = h_lr_consume_input(p->arena, &p->input);
+  sym->alts = NULL;
+  sym->next = NULL;
+
+  p->level++;
+  p->frontier = NULL;
+  p->symbols = NULL;
+  p->epsedges = false;
+  return sym;
+}
 
-/* GLR driver */
+// perform pending shifts. returns the new top node if only one stack is
+// left, otherwise schedules the actions of all new nodes and returns NULL.
+static HGLRNode *shifter(HGLRParse *p)
+{
+  // swap shift lists
+  HSlist *tmp = p->shifts;
+  p->shifts = p->nextshifts;
+  p->nextshifts = tmp;
+
+  HGLRSymbol *sym = next_level(p);
+  while(!h_slist_empty(p->shifts)) {
+    HGLRShift *s = h_slist_pop(p->shifts);
+    HGLRNode *w = gss_lookup(p, s->nextstate);
+    if(w == NULL)
+      w = gss_node(p, s->nextstate);
+    gss_edge(p, w, s->node, sym);
+  }
+
+  HGLRNode *v = p->frontier;
+  if(v && !v->next && !v->edges->next)
+    return v;
+
+  for(; v; v=v->next) {
+    for(HGLREdge *e=v->edges; e; e=e->next)
+      actor(p, v, e, e == v->edges);
+  }
+  return NULL;
+}
 
-static bool glr_step(HParseResult **result, HSlist *engines,
-                     HLREngine *engine, const HLRAction *action)
+// deterministic fast path: while only one stack is alive and its actions are
+// unambiguous, step it directly (like h_lrengine_step) instead of going
+// through the work lists. returns false when the parse is finished.
+static bool glr_fast(HGLRParse *p, HGLRNode *v)
 {
-  // handle forks and demerges (~> spawn engines)
-  if(action) {
-    if(action->type == HLR_CONFLICT) {
-      // fork engine on conflicts
-      action = handle_conflict(result, engines, engine, action->branches);
-    } else if(action->type == HLR_REDUCE) {
-      // demerge/respawn as needed
-      size_t depth = action->production.length;
-      engine = demerge(result, engines, engine, action, depth);
+  for(;;) {
+    const HLRAction *action = h_lrtable_action(p->table, v->state, &p->input);
+    if(action == NULL)
+      return false;     // the only stack dies
+    if(action->type == HLR_CONFLICT)
+      break;
+
+    if(action->type == HLR_SHIFT) {
+      HGLRSymbol *sym = next_level(p);
+      HGLRNode *w = gss_node(p, action->nextstate);
+      gss_edge(p, w, v, sym);
+      v = w;
+      continue;
     }
-  }
 
-  bool run = h_lrengine_step(engine, action);
-  
-  if(run) {
-    // store engine in the list, merge if necessary
-    HSlistNode *x;
-    for(x=engines->head; x; x=x->next) {
-      HLREngine *eng = x->elem;
-      if(eng->state == engine->state) {
-        x->elem = lrengine_merge(eng, engine);
+    // reduce, if the path to take is unique
+    assert(action->type == HLR_REDUCE);
+    size_t k = action->production.length;
+    HGLRSymbol *children[k > 0 ? k : 1];
+    HGLRNode *u = v;
+    for(; k > 0; k--) {
+      HGLREdge *e = u->edges;
+      if(e == NULL || e->next != NULL)
         break;
-      }
+      children[k-1] = e->sym;
+      u = e->to;
+    }
+    if(k > 0)
+      break;
+
+    const HLRAction *shift = h_lrtable_goto(p->table, u->state, action);
+    if(shift == NULL)
+      return false;     // parse error
+    assert(shift->type == HLR_SHIFT);
+    if(shift->nextstate != HLR_SUCCESS && gss_lookup(p, shift->nextstate))
+      break;            // joins another stack
+
+    HGLRSymbol *sym = forest_symbol(p, action, u->level, children);
+    if(sym == NULL)
+      return false;     // validation failed
+
+    if(shift->nextstate == HLR_SUCCESS) {
+      assert(action->production.lhs == p->table->start);
+      p->accept = sym;
+      return false;
     }
-    if(!x)  // no merge happened
-      h_slist_push(engines, engine);
-  } else if(engine->state == HLR_SUCCESS) {
-    // save the result
-    *result = h_lrengine_result(engine);
+
+    HGLRNode *w = gss_node(p, shift->nextstate);
+    gss_edge(p, w, u, sym);
+    v = w;
   }
 
-  return run;
+  // hand over to the general algorithm.
+  // NB: v has at most one edge here, so all its paths go through it.
+  actor(p, v, v->edges, true);
+  return true;
 }
 
-HParseResult *h_glr_parse(HAllocator* mm__, const HParser* parser, HInputStream* stream)
+
+/* GLR driver */
+
+HParseResult *h_glr_parse(HAllocator* mm__, const HParser* parser, HInputStream* stream, HArena *parent)
 {
   HLRTable *table = parser->backend_data;
   if(!table)
     return NULL;
 
-  HArena *arena  = h_new_arena(mm__, 0);    // will hold the results
-  HArena *tarena = h_new_arena(mm__, 0);    // tmp, deleted after parse
+  HArena *arena  = parent ? parent : h_new_arena(mm__, 0); // will hold the results
+  HArena *tarena = h_parse_scratch(mm__, parent);           // tmp, given up after parse
+
+  HGLRParse p = {
+    .table = table,
+    .arena = arena,
+    .tarena = tarena,
+    .input = *stream,
+    .base = stream->index,
+    .reductions = h_slist_new(tarena),
+    .shifts = h_slist_new(tarena),
+    .nextshifts = h_slist_new(tarena),
+  };
+  p.top = h_arena_malloc(tarena, table->nrows * sizeof(HGLRNode *));
+  p.stamp = h_arena_malloc(tarena, table->nrows * sizeof(size_t));
+  memset(p.stamp, 0, table->nrows * sizeof(size_t));
+
+  // start with the initial stack on the fast path
+  bool run = glr_fast(&p, gss_node(&p, 0));
+
+  // process input token by token
+  while(run) {
+    while(!h_slist_empty(p.reductions)) {
+      HGLRReduction *r = h_slist_pop(p.reductions);
+      size_t len = r->action->production.length;
+      HGLRSymbol *children[len > 0 ? len : 1];
+      reduce_paths(&p, r->node, r->action, len, children, r->via, false);
+    }
 
-  // allocate engine lists (will hold one engine per state)
-  // these are swapped each iteration
-  HSlist *engines = h_slist_new(tarena);
-  HSlist *engback = h_slist_new(tarena);
+    // the first stack to reach acceptance wins
+    if(p.accept || h_slist_empty(p.nextshifts))
+      break;
 
-  // create initial engine
-  h_slist_push(engines, h_lrengine_new(arena, tarena, table, stream));
+    HGLRNode *v = shifter(&p);
+    if(v)
+      run = glr_fast(&p, v);
+  }
 
+  // run the semantic actions on the winning derivation
   HParseResult *result = NULL;
-  while(result == NULL && !h_slist_empty(engines)) {
-    assert(h_slist_empty(engback));
-
-    // step all engines
-    while(!h_slist_empty(engines)) {
-      HLREngine *engine = h_slist_pop(engines);
-      const HLRAction *action = h_lrengine_action(engine);
-      glr_step(&result, engback, engine, action);
-    }
-
-    // swap the lists
-    HSlist *tmp = engines;
-    engines = engback;
-    engback = tmp;
-  }
+  if(p.accept && forest_value(&p, p.accept))
+    result = make_result(arena, p.accept->value);
 
-  if(!result)
+  if(!result && !parent)
     h_delete_arena(arena);
-  h_delete_arena(tarena);
+  h_parse_scratch_done(parent, tarena);
   return result;
 }
 
@@ -1,138 +1,269 @@
 #include <assert.h>
+#include <string.h>
 #include "contextfree.h"
 #include "lr.h"
 
 
 
-/* LALR-via-SLR grammar transformation */
-
-static inline size_t seqsize(void *p_)
+/* LALR(1) lookaheads after DeRemer and Pennello
+ *
+ * [DeRemer, Pennello: Efficient Computation of LALR(1) Look-Ahead Sets. 1982]
+ *
+ * The lookaheads are computed directly on the LR(0) automaton. For each
+ * nonterminal transition (p,A):
+ *
+ *   DR(p,A)     = { t | p -A-> r -t-> }
+ *   (p,A) reads (r,C)       iff  p -A-> r -C->  and  C =>* ""
+ *   Read(p,A)   = DR(p,A) u U{ Read(r,C) | (p,A) reads (r,C) }
+ *   (p,A) includes (p',B)   iff  B -> x A y,  p' -x-> p  and  y =>* ""
+ *   Follow(p,A) = Read(p,A) u U{ Follow(p',B) | (p,A) includes (p',B) }
+ *
+ * The lookahead set of a reduction "A -> w" in state q is the union of
+ * Follow(p,A) for all p such that p -w-> q.
+ *
+ * Read and Follow are computed by the "digraph" algorithm, a variant of
+ * Tarjan's which assigns the same set to all members of a cycle (strongly
+ * connected component) of the respective relation.
+ */
+
+#define NO_NT ((size_t)~0)
+
+// an outgoing transition of a DFA state
+typedef struct HLREdge_ {
+  const HCFChoice *symbol;
+  size_t to;
+  size_t nt;    // index of this transition among the nonterminal ones
+} HLREdge;
+
+typedef struct HLRLookahead_ {
+  HCFGrammar *grammar;
+  HArena     *arena;
+  size_t     nstates;
+  size_t     *nout;     // per state: number of outgoing transitions
+  HLREdge    **out;     // per state: outgoing transitions
+  HSlist     **in;      // per state: incoming transitions (HLRTransition)
+  size_t     nnt;       // number of nonterminal transitions
+  size_t     *ntfrom;   // source state of each nonterminal transition
+  HLREdge    **nt;      // nonterminal transitions
+  HSlist     **rel;     // scratch: relation (reads/includes) as adj. lists
+  HLRTermSet *follow;   // per nonterminal transition: Read, then Follow
+} HLRLookahead;
+
+static inline bool is_nonterminal(const HCFChoice *sym)
 {
-  size_t n=0;
-  for(void **p=p_; *p; p++) n++;
-  return n+1;
+  return (sym->type == HCF_CHOICE || sym->type == HCF_CHARSET);
 }
 
-static HLRAction *
-lrtable_lookup(const HLRTable *table, size_t state, const HCFChoice *symbol)
+// find the transition from state p on symbol X
+static const HLREdge *edge(const HLRLookahead *la, size_t p, const HCFChoice *X)
 {
-  switch(symbol->type) {
-  case HCF_END:
-    return table->tmap[state]->end_branch;
-  case HCF_CHAR:
-    return h_stringmap_get(table->tmap[state], &symbol->chr, 1, false);
-  default:
-    // nonterminal case
-    return h_hashtable_get(table->ntmap[state], symbol);
+  for(size_t i=0; i<la->nout[p]; i++) {
+    if(h_eq_symbol(la->out[p][i].symbol, X))
+      return &la->out[p][i];
   }
+  return NULL;
 }
 
-static size_t follow_transition(const HLRTable *table, size_t x, HCFChoice *A)
-{
-  HLRAction *action = lrtable_lookup(table, x, A);
-  assert(action != NULL);
-  assert(action->type == HLR_SHIFT);
-  return action->nextstate;
-}
-
-static inline HLRTransition *transition(HArena *arena,
-                                        size_t x, const HCFChoice *A, size_t y)
-{
-  HLRTransition *t = h_arena_malloc(arena, sizeof(HLRTransition));
-  t->from = x;
-  t->symbol = A;
-  t->to = y;
-  return t;
-}
-
-// no-op on terminal symbols
-static void transform_productions(const HLRTable *table, HLREnhGrammar *eg,
-                                  size_t x, HCFChoice *xAy)
+static void digraph_traverse(HLRLookahead *la, size_t *N,
+                             size_t *stack, size_t *sp, size_t x)
 {
-  if(xAy->type != HCF_CHOICE)
-    return;
-  // XXX CHARSET?
-
-  HArena *arena = eg->arena;
-
-  HCFSequence **seq = h_arena_malloc(arena, seqsize(xAy->seq)
-                                            * sizeof(HCFSequence *));
-  HCFSequence **p, **q;
-  for(p=xAy->seq, q=seq; *p; p++, q++) {
-    // trace rhs starting in state x and following the transitions
-    // xAy -> ... iBj ...
-
-    size_t i = x;
-    HCFChoice **B = (*p)->items;
-    HCFChoice **items = h_arena_malloc(arena, seqsize(B) * sizeof(HCFChoice *));
-    HCFChoice **iBj = items;
-    for(; *B; B++, iBj++) {
-      size_t j = follow_transition(table, i, *B);
-      HLRTransition *i_B_j = transition(arena, i, *B, j);
-      *iBj = h_hashtable_get(eg->tmap, i_B_j);
-      assert(*iBj != NULL);
-      i = j;
-    }
-    *iBj = NULL;
+  stack[(*sp)++] = x;
+  size_t d = *sp;
+  N[x] = d;
+
+  for(HSlistNode *e=la->rel[x]->head; e; e=e->next) {
+    size_t y = (uintptr_t)e->elem;
+    if(N[y] == 0)
+      digraph_traverse(la, N, stack, sp, y);
+    if(N[y] < N[x])
+      N[x] = N[y];
+    tset_union(&la->follow[x], &la->follow[y]);
+  }
 
-    *q = h_arena_malloc(arena, sizeof(HCFSequence));
-    (*q)->items = items;
+  if(N[x] == d) {
+    // x is the root of a strongly connected component; pop it
+    size_t y;
+    do {
+      y = stack[--(*sp)];
+      N[y] = (size_t)~0;
+      la->follow[y] = la->follow[x];
+    } while(y != x);
   }
-  *q = NULL;
-  xAy->seq = seq;
 }
 
-static HCFChoice *new_enhanced_symbol(HLREnhGrammar *eg, const HCFChoice *sym)
+// close la->follow under la->rel, then clear the relation
+static void digraph(HLRLookahead *la)
 {
-  HArena *arena = eg->arena;
-  HCFChoice *esym = h_arena_malloc(arena, sizeof(HCFChoice));
-  *esym = *sym;
-
-  HHashSet *cs = h_hashtable_get(eg->corr, sym);
-  if(!cs) {
-    cs = h_hashset_new(arena, h_eq_symbol, h_hash_symbol);
-    h_hashtable_put(eg->corr, sym, cs);
+  size_t *N = h_arena_malloc(la->arena, la->nnt * sizeof(size_t));
+  size_t *stack = h_arena_malloc(la->arena, la->nnt * sizeof(size_t));
+  size_t sp = 0;
+
+  for(size_t x=0; x<la->nnt; x++)
+    N[x] = 0;
+  for(size_t x=0; x<la->nnt; x++) {
+    if(N[x] == 0)
+      digraph_traverse(la, N, stack, &sp, x);
   }
-  h_hashset_put(cs, esym);
 
-  return esym;
+  for(size_t x=0; x<la->nnt; x++)
+    la->rel[x] = h_slist_new(la->arena);
 }
 
-static HLREnhGrammar *enhance_grammar(const HCFGrammar *g, const HLRDFA *dfa,
-                                      const HLRTable *table)
+static HLRLookahead *lookahead_new(HCFGrammar *g, const HLRDFA *dfa)
 {
-  HAllocator *mm__ = g->mm__;
   HArena *arena = g->arena;
-
-  HLREnhGrammar *eg = h_arena_malloc(arena, sizeof(HLREnhGrammar));
-  eg->tmap = h_hashtable_new(arena, h_eq_transition, h_hash_transition);
-  eg->smap = h_hashtable_new(arena, h_eq_ptr, h_hash_ptr);
-  eg->corr = h_hashtable_new(arena, h_eq_symbol, h_hash_symbol);
-  // XXX must use h_eq/hash_ptr for symbols! so enhanced CHARs are different
-  eg->arena = arena;
-
-  // establish mapping between transitions and symbols
+  size_t n = dfa->nstates;
+
+  HLRLookahead *la = h_arena_malloc(arena, sizeof(HLRLookahead));
+  la->grammar = g;
+  la->arena = arena;
+  la->nstates = n;
+  la->nout = h_arena_malloc(arena, n * sizeof(size_t));
+  la->out = h_arena_malloc(arena, n * sizeof(HLREdge *));
+  la->in = h_arena_malloc(arena, n * sizeof(HSlist *));
+
+  // index the transitions by state. state 0 gets an extra (virtual) transition
+  // on the start symbol into the accepting state.
+  for(size_t i=0; i<n; i++) {
+    la->nout[i] = 0;
+    la->in[i] = h_slist_new(arena);
+  }
+  la->nout[0]++;
+  for(HSlistNode *x=dfa->transitions->head; x; x=x->next) {
+    HLRTransition *t = x->elem;
+    la->nout[t->from]++;
+    h_slist_push(la->in[t->to], t);
+  }
+  for(size_t i=0; i<n; i++) {
+    la->out[i] = h_arena_malloc(arena, la->nout[i] * sizeof(HLREdge));
+    la->nout[i] = 0;
+  }
+  la->out[0][la->nout[0]++] = (HLREdge){g->start, HLR_SUCCESS, NO_NT};
   for(HSlistNode *x=dfa->transitions->head; x; x=x->next) {
     HLRTransition *t = x->elem;
+    la->out[t->from][la->nout[t->from]++] = (HLREdge){t->symbol, t->to, NO_NT};
+  }
+
+  // number the nonterminal transitions
+  la->nnt = 0;
+  for(size_t i=0; i<n; i++) {
+    for(size_t j=0; j<la->nout[i]; j++) {
+      if(is_nonterminal(la->out[i][j].symbol))
+        la->out[i][j].nt = la->nnt++;
+    }
+  }
+  la->ntfrom = h_arena_malloc(arena, la->nnt * sizeof(size_t));
+  la->nt = h_arena_malloc(arena, la->nnt * sizeof(HLREdge *));
+  la->rel = h_arena_malloc(arena, la->nnt * sizeof(HSlist *));
+  la->follow = h_arena_malloc(arena, la->nnt * sizeof(HLRTermSet));
+  for(size_t i=0; i<n; i++) {
+    for(size_t j=0; j<la->nout[i]; j++) {
+      HLREdge *e = &la->out[i][j];
+      if(e->nt == NO_NT)
+        continue;
+      la->ntfrom[e->nt] = i;
+      la->nt[e->nt] = e;
+      la->rel[e->nt] = h_slist_new(arena);
+    }
+  }
 
-    assert(!h_hashtable_present(eg->tmap, t));
+  // DR and the reads relation
+  for(size_t x=0; x<la->nnt; x++) {
+    HLRTermSet *dr = &la->follow[x];
+    size_t r = la->nt[x]->to;
+
+    memset(dr, 0, sizeof(HLRTermSet));
+    if(r == HLR_SUCCESS) {      // the start symbol is followed by the end
+      tset_add(dr, TSET_END);
+      continue;
+    }
 
-    HCFChoice *sym = new_enhanced_symbol(eg, t->symbol);
-    h_hashtable_put(eg->tmap, t, sym);
-    h_hashtable_put(eg->smap, sym, t);
+    for(size_t j=0; j<la->nout[r]; j++) {
+      const HLREdge *e = &la->out[r][j];
+      switch(e->symbol->type) {
+      case HCF_CHAR:
+        tset_add(dr, e->symbol->chr);
+        break;
+      case HCF_END:
+        tset_add(dr, TSET_END);
+        break;
+      default:
+        if(h_derives_epsilon(g, e->symbol))
+          h_slist_push(la->rel[x], (void *)(uintptr_t)e->nt);
+      }
+    }
+  }
+  digraph(la);  // follow = Read
+
+  // the includes relation
+  for(size_t y=0; y<la->nnt; y++) {
+    const HCFChoice *B = la->nt[y]->symbol;
+    if(B->type != HCF_CHOICE)
+      continue;     // the productions of a charset consist of terminals
+
+    for(HCFSequence **p=B->seq; *p; p++) {
+      HCFChoice **rhs = (*p)->items;
+      size_t len = 0;
+      while(rhs[len]) len++;
+
+      // only positions followed by a nullable suffix are of interest
+      size_t k = len;
+      while(k > 0 && h_derives_epsilon(g, rhs[k-1]))
+        k--;
+      if(k > 0) k--;    // the last non-nullable symbol itself
+
+      // trace the production from the transition's source state
+      size_t q = la->ntfrom[y];
+      for(size_t i=0; i<len; i++) {
+        const HLREdge *e = edge(la, q, rhs[i]);
+        assert(e != NULL);
+        if(i >= k && e->nt != NO_NT)
+          h_slist_push(la->rel[e->nt], (void *)(uintptr_t)y);
+        q = e->to;
+      }
+    }
   }
+  digraph(la);  // follow = Follow
 
-  // transform the productions
-  H_FOREACH(eg->tmap, HLRTransition *t, HCFChoice *sym)
-    transform_productions(table, eg, t->from, sym);
-  H_END_FOREACH
+  return la;
+}
 
-  // add the start symbol
-  HCFChoice *start = new_enhanced_symbol(eg, g->start);
-  transform_productions(table, eg, 0, start);
+// compute the lookahead set of a reducible item in state q
+static void lookahead_item(const HLRLookahead *la, size_t q,
+                           const HLRItem *item, HLRTermSet *out)
+{
+  HArena *arena = la->arena;
+  HSlist *states = h_slist_new(arena);
+  h_slist_push(states, (void *)(uintptr_t)q);
+
+  // trace the rhs backwards to find the states where it started
+  for(size_t i=item->len; i>0; i--) {
+    const HCFChoice *sym = item->rhs[i-1];
+    HSlist *preds = h_slist_new(arena);
+    for(HSlistNode *x=states->head; x; x=x->next) {
+      size_t s = (uintptr_t)x->elem;
+      for(HSlistNode *y=la->in[s]->head; y; y=y->next) {
+        const HLRTransition *t = y->elem;
+        if(!h_eq_symbol(t->symbol, sym))
+          continue;
+        HSlistNode *z;
+        for(z=preds->head; z; z=z->next)
+          if((uintptr_t)z->elem == t->from)
+            break;
+        if(z == NULL)
+          h_slist_push(preds, (void *)(uintptr_t)t->from);
+      }
+    }
+    states = preds;
+  }
 
-  eg->grammar = h_cfgrammar_(mm__, start);
-  return eg;
+  memset(out, 0, sizeof(HLRTermSet));
+  for(HSlistNode *x=states->head; x; x=x->next) {
+    const HLREdge *e = edge(la, (uintptr_t)x->elem, item->lhs);
+    assert(e != NULL);
+    assert(e->nt != NO_NT);
+    tset_union(out, &la->follow[e->nt]);
+  }
 }
 
 
@@ -144,65 +275,165 @@ static inline bool has_conflicts(HLRTable *table)
   return !h_slist_empty(table->inadeq);
 }
 
-// for each lookahead symbol (fs), put action into tmap
+// put action into a table cell, recording conflicts
+// returns 0 on success, -1 on conflict
+static int cell_put(HArena *arena, void **cell, HLRAction *action)
+{
+  HLRAction *prev = *cell;
+  if(prev && prev != action) {
+    *cell = h_lr_conflict(arena, prev, action);
+    return -1;
+  } else {
+    *cell = action;
+    return 0;
+  }
+}
+
+// for each lookahead symbol in la, put action into tmap
 // returns 0 on success, -1 on conflict
-// ignores forall entries
-static int terminals_put(HStringMap *tmap, const HStringMap *fs, HLRAction *action)
+static int terminals_put(HStringMap *tmap, const HLRTermSet *la,
+                         HLRAction *action)
 {
   int ret = 0;
 
-  if(fs->epsilon_branch) {
-    HLRAction *prev = tmap->epsilon_branch;
-    if(prev && prev != action) {
-      // conflict
-      tmap->epsilon_branch = h_lr_conflict(tmap->arena, prev, action);
+  if(tset_member(la, TSET_END)) {
+    if(cell_put(tmap->arena, &tmap->end_branch, action) < 0)
       ret = -1;
-    } else {
-      tmap->epsilon_branch = action;
-    }
   }
 
-  if(fs->end_branch) {
-    HLRAction *prev = tmap->end_branch;
-    if(prev && prev != action) {
-      // conflict
-      tmap->end_branch = h_lr_conflict(tmap->arena, prev, action);
-      ret = -1;
+  for(unsigned int c=0; c<256; c++) {
+    if(!tset_member(la, c))
+      continue;
+
+    HStringMap *m = h_stringmap_get_char(tmap, c);
+    if(!m) {
+      h_stringmap_put_char(tmap, c, action);
     } else {
-      tmap->end_branch = action;
+      if(cell_put(tmap->arena, &m->epsilon_branch, action) < 0)
+        ret = -1;
     }
   }
 
-  H_FOREACH(fs->char_branches, void *key, HStringMap *fs_)
-    HStringMap *tmap_ = h_hashtable_get(tmap->char_branches, key);
+  return ret;
+}
 
-    if(!tmap_) {
-      tmap_ = h_stringmap_new(tmap->arena);
-      h_hashtable_put(tmap->char_branches, key, tmap_);
-    }
 
-    if(terminals_put(tmap_, fs_, action) < 0)
-      ret = -1;
+
+
+/* Precedence and associativity (see h_left_assoc)
+ *
+ * Shift/reduce conflicts are settled like yacc does, except that precedence
+ * is attached to productions rather than terminals: a production has that of
+ * its lhs, or else that of the last annotated symbol in its rhs. The
+ * precedence of shifting a terminal is that of the productions whose items
+ * shift it; all of them must agree.
+ */
+
+// the only symbol on the rhs of a unit production "A -> x" (or NULL)
+static const HCFChoice *unit_rhs(const HCFChoice *A)
+{
+  if(A->type != HCF_CHOICE || !A->seq[0] || A->seq[1])
+    return NULL;
+  HCFChoice **rhs = A->seq[0]->items;
+  if(!rhs[0] || rhs[1] || !is_nonterminal(rhs[0]))
+    return NULL;
+  return rhs[0];
+}
+
+// map the annotated nonterminals to themselves, and the ones they wrap (by
+// a chain of unit productions) to them. returns NULL if there are none.
+static HHashTable *precedences(HCFGrammar *g)
+{
+  HHashTable *prec = NULL;
+
+  H_FOREACH_KEY(g->nts, HCFChoice *A)
+    if(A->prec == 0)
+      continue;
+    if(prec == NULL)
+      prec = h_hashtable_new(g->arena, h_eq_ptr, h_hash_ptr);
+    h_hashtable_put(prec, A, (void *)A);
+    const HCFChoice *x = A;
+    while((x = unit_rhs(x)) && x->prec == 0 && !h_hashtable_present(prec, x))
+      h_hashtable_put(prec, x, (void *)A);
   H_END_FOREACH
 
-  return ret;
+  return prec;
+}
+
+// the annotated symbol that gives the production of item its precedence
+static const HCFChoice *prod_prec(const HHashTable *prec, const HLRItem *item)
+{
+  const HCFChoice *p = h_hashtable_get(prec, item->lhs);
+  for(size_t i=item->len; !p && i>0; i--)
+    p = h_hashtable_get(prec, item->rhs[i-1]);
+  return p;
 }
 
-// check whether a sequence of enhanced-grammar symbols (p) matches the given
-// (original-grammar) production rhs and terminates in the given end state.
-static bool match_production(HLREnhGrammar *eg, HCFChoice **p,
-                             HCFChoice **rhs, size_t endstate)
+// the precedence of shifting terminal t in state st (or NULL)
+static const HCFChoice *shift_prec(const HHashTable *prec, const HLRState *st,
+                                   size_t t)
 {
-  size_t state = endstate;  // initialized to end in case of empty rhs
-  for(; *p && *rhs; p++, rhs++) {
-    HLRTransition *t = h_hashtable_get(eg->smap, *p);
-    assert(t != NULL);
-    if(!h_eq_symbol(t->symbol, *rhs))
-      return false;
-    state = t->to;
+  const HCFChoice *p = NULL;
+
+  for(size_t i=0; i<st->nitems; i++) {
+    const HLRItem *item = st->items[i];
+    if(item->mark == item->len)
+      continue;
+    const HCFChoice *x = item->rhs[item->mark];
+    if(!(t == TSET_END && x->type == HCF_END)
+       && !(x->type == HCF_CHAR && x->chr == t))
+      continue;
+
+    const HCFChoice *q = prod_prec(prec, item);
+    if(q == NULL || (p && q->prec != p->prec))
+      return NULL;
+    p = q;
+  }
+
+  return p;
+}
+
+// settle the shift/reduce conflicts between a reducible item with lookahead
+// la and the shifts in the row tmap of state st. the losing side is removed
+// from la or from tmap; both are removed for an error (h_nonassoc).
+static void resolve_prec(const HHashTable *prec, const HLRState *st,
+                         const HLRItem *item, HLRTermSet *la, HStringMap *tmap)
+{
+  const HCFChoice *r = prod_prec(prec, item);
+  if(r == NULL)
+    return;
+
+  for(size_t t=0; t<=TSET_END; t++) {
+    if(!tset_member(la, t))
+      continue;
+
+    const HLRAction *action;
+    if(t == TSET_END) {
+      action = tmap->end_branch;
+    } else {
+      HStringMap *m = h_stringmap_get_char(tmap, t);
+      action = m? m->epsilon_branch : NULL;
+    }
+    if(action == NULL || action->type != HLR_SHIFT)
+      continue;
+
+    const HCFChoice *s = shift_prec(prec, st, t);
+    if(s == NULL)
+      continue;
+
+    bool reduce = r->prec > s->prec
+                  || (r->prec == s->prec && s->assoc == HCF_LEFT_ASSOC);
+    bool shift = r->prec < s->prec
+                 || (r->prec == s->prec && s->assoc == HCF_RIGHT_ASSOC);
+    if(!shift) {  // drop the shift
+      if(t == TSET_END)
+        tmap->end_branch = NULL;
+      else
+        h_hashtable_del(tmap->char_branches, (void *)char_key(t));
+    }
+    if(!reduce)
+      tset_del(la, t);
   }
-  return (*p == *rhs    // both NULL
-          && state == endstate);
 }
 
 // desugar parser with a fresh start symbol
@@ -224,12 +455,66 @@ HCFChoice *h_desugar_augmented(HAllocator *mm__, HParser *parser)
   return augmented;
 }
 
+// replace the forall reductions of inadequate states by reductions on their
+// lookaheads: those of the LR(1) automaton, or else the LALR(1) lookaheads.
+// if given, prec settles shift/reduce conflicts (see precedences).
+static void put_lookaheads(HCFGrammar *g, const HLRDFA *dfa, HLRTable *table,
+                           const HHashTable *prec)
+{
+  HArena *arena = table->arena;
+  HLRLookahead *la = NULL;
+
+  // go through the inadequate states; replace inadeq with a new list
+  HSlist *inadeq = table->inadeq;
+  table->inadeq = h_slist_new(arena);
+
+  for(HSlistNode *x=inadeq->head; x; x=x->next) {
+    size_t state = (uintptr_t)x->elem;
+    bool inadeq = false;
+
+    // clear old forall entry, it's being replaced by more fine-grained ones
+    table->forall[state] = NULL;
+
+    // go through each reducible item of state
+    const HLRState *st = dfa->states[state];
+    for(size_t i=0; i<st->nitems; i++) {
+      const HLRItem *item = st->items[i];
+      if(item->mark < item->len)
+        continue;
+
+      // action to place in the table cells indicated by lookahead
+      HLRAction *action = h_reduce_action(arena, item);
+
+      HLRTermSet fs;
+      if(st->lookahead) {
+        fs = st->lookahead[i];
+      } else {
+        if(la == NULL)
+          la = lookahead_new(g, dfa);
+        lookahead_item(la, state, item, &fs);
+      }
+      if(prec)
+        resolve_prec(prec, st, item, &fs, table->tmap[state]);
+
+      // for each lookahead symbol, put action into table cell
+      if(terminals_put(table->tmap[state], &fs, action) < 0)
+        inadeq = true;
+    } // reducible item
+
+    if(inadeq)
+      h_slist_push(table->inadeq, (void *)(uintptr_t)state);
+  }
+}
+
 int h_lalr_compile(HAllocator* mm__, HParser* parser, const void* params)
 {
+  const HLRParams *lp = params;
+
   // generate (augmented) CFG from parser
   // construct LR(0) DFA
   // build LR(0) table
-  // if necessary, resolve conflicts "by conversion to SLR"
+  // if necessary, resolve conflicts by computing LALR(1) lookaheads
+  // if that fails, and so requested, construct LR(1) DFA and table instead
 
   HCFGrammar *g = h_cfgrammar_(mm__, h_desugar_augmented(mm__, parser));
   if(g == NULL)     // backend not suitable (language not context-free)
@@ -247,64 +532,24 @@ int h_lalr_compile(HAllocator* mm__, HParser* parser, const void* params)
     return -1;
   }
 
-  if(has_conflicts(table)) {
-    HArena *arena = table->arena;
+  HHashTable *prec = precedences(g);
+  if(has_conflicts(table))
+    put_lookaheads(g, dfa, table, prec);
 
-    HLREnhGrammar *eg = enhance_grammar(g, dfa, table);
-    if(eg == NULL) {    // this should normally not happen
-      h_cfgrammar_free(g);
+  if(has_conflicts(table) && lp && lp->lr1) {
+    HLRDFA *dfa1 = h_lr1_dfa(g);
+    HLRTable *table1 = dfa1? h_lr0_table(g, dfa1) : NULL;
+    if(table1) {
+      if(has_conflicts(table1))
+        put_lookaheads(g, dfa1, table1, prec);
       h_lrtable_free(table);
-      return -1;
-    }
-
-    // go through the inadequate states; replace inadeq with a new list
-    HSlist *inadeq = table->inadeq;
-    table->inadeq = h_slist_new(arena);
-    
-    for(HSlistNode *x=inadeq->head; x; x=x->next) {
-      size_t state = (uintptr_t)x->elem;
-      bool inadeq = false;
-      
-      // clear old forall entry, it's being replaced by more fine-grained ones
-      table->forall[state] = NULL;
-
-      // go through each reducible item of state
-      H_FOREACH_KEY(dfa->states[state], HLRItem *item)
-        if(item->mark < item->len)
-          continue;
-
-        // action to place in the table cells indicated by lookahead
-        HLRAction *action = h_reduce_action(arena, item);
-
-        // find all LR(0)-enhanced productions matching item
-        HHashSet *lhss = h_hashtable_get(eg->corr, item->lhs);
-        assert(lhss != NULL);
-        H_FOREACH_KEY(lhss, HCFChoice *lhs)
-          assert(lhs->type == HCF_CHOICE);  // XXX could be CHARSET?
-
-          for(HCFSequence **p=lhs->seq; *p; p++) {
-            HCFChoice **rhs = (*p)->items;
-            if(!match_production(eg, rhs, item->rhs, state))
-              continue;
-
-            // the left-hand symbol's follow set is this production's
-            // contribution to the lookahead
-            const HStringMap *fs = h_follow(1, eg->grammar, lhs);
-            assert(fs != NULL);
-            assert(fs->epsilon_branch == NULL);
-            assert(!h_stringmap_empty(fs));
-
-            // for each lookahead symbol, put action into table cell
-            if(terminals_put(table->tmap[state], fs, action) < 0)
-              inadeq = true;
-        } H_END_FOREACH // enhanced production
-      H_END_FOREACH  // reducible item
-
-      if(inadeq)
-        h_slist_push(table->inadeq, (void *)(uintptr_t)state);
+      table = table1;
+      dfa = dfa1;
     }
   }
 
+  h_lrtable_pack(table);
+  h_lrtable_spans(table, g, dfa);
   h_cfgrammar_free(g);
   parser->backend_data = table;
   return has_conflicts(table)? -1 : 0;
@@ -1,4 +1,5 @@
 #include <assert.h>
+#include <string.h>
 #include "../internal.h"
 #include "../cfgrammar.h"
 #include "../parsers/parser_internal.h"
@@ -13,12 +14,24 @@ static const size_t DEFAULT_KMAX = 1;
  */
 typedef struct HLLkTable_ {
   HHashTable *rows;
+  HHashTable *spans;    // maps loop nonterminals to HLLkSpans, see below
   HCFChoice  *start;    // start symbol
+  uint8_t    bclass[256];   // byte classes of the grammar
   HArena     *arena;
   HAllocator *mm__;
 } HLLkTable;
 
 
+/* A nonterminal x -> t x | "" whose row predicts "t x" on exactly the bytes
+ * of t (at depth 1) can consume a whole run of t in one step.
+ * Cf. h_span_terminal.
+ */
+typedef struct HLLkSpan_ {
+  HSpanSet set;               // the bytes of t
+  const HCFSequence *loop;    // the production "x -> t x"
+} HLLkSpan;
+
+
 /* Interface to look up an entry in the parse table. */
 const HCFSequence *h_llk_lookup(const HLLkTable *table, const HCFChoice *x,
                                 const HInputStream *stream)
@@ -29,7 +42,7 @@ const HCFSequence *h_llk_lookup(const HLLkTable *table, const HCFChoice *x,
   assert(!row->epsilon_branch); // would match without looking at the input
                                 // XXX cases where this could be useful?
 
-  return h_stringmap_get_lookahead(row, *stream);
+  return h_stringmap_get_lookahead(row, table->bclass, *stream);
 }
 
 /* Allocate a new parse table. */
@@ -41,12 +54,15 @@ HLLkTable *h_llktable_new(HAllocator *mm__)
   assert(arena != NULL);
   HHashTable *rows = h_hashtable_new(arena, h_eq_ptr, h_hash_ptr);
   assert(rows != NULL);
+  HHashTable *spans = h_hashtable_new(arena, h_eq_ptr, h_hash_ptr);
+  assert(spans != NULL);
 
   HLLkTable *table = h_new(HLLkTable, 1);
   assert(table != NULL);
   table->mm__  = mm__;
   table->arena = arena;
   table->rows  = rows;
+  table->spans = spans;
 
   return table;
 }
@@ -118,10 +134,12 @@ static void stringmap_merge(HHashSet *workset, HStringMap *dst, HStringMap *src)
 
       if(src_) {
         HStringMap *dst_ = h_hashtable_get(dst->char_branches, (void *)c);
-        if(dst_)
-          stringmap_merge(workset, dst_, src_);
-        else
-          h_hashtable_put(dst->char_branches, (void *)c, src_);
+        if(!dst_) {
+          // copy rather than share src_, which lives in the grammar's arena
+          dst_ = h_stringmap_new(dst->arena);
+          h_hashtable_put(dst->char_branches, (void *)c, dst_);
+        }
+        stringmap_merge(workset, dst_, src_);
       }
     }
   }
@@ -181,12 +199,44 @@ static int fill_table_row(size_t kmax, HCFGrammar *g, HStringMap *row,
   return (k>kmax)? -1 : 0;
 }
 
+/* If nonterminal a is a loop over a terminal whose run can be consumed in one
+ * step, record it in table->spans.
+ */
+static void fill_span(HCFGrammar *g, HLLkTable *table, const HCFChoice *a)
+{
+  const HCFChoice *t = h_span_terminal(g, a);
+  if(t == NULL)
+    return;
+
+  const HCFSequence *loop = a->seq[0]->items[0]? a->seq[0] : a->seq[1];
+  const HStringMap *row = h_hashtable_get(table->rows, a);
+  HCharset set = h_arena_malloc(table->arena, 256);
+  memset(set, 0, 256);
+
+  for(unsigned int c=0; c<256; c++) {
+    if(t->type == HCF_CHAR? c != t->chr : !charset_isset(t->charset, c))
+      continue;
+
+    // the loop must be predicted by the first byte alone
+    const HStringMap *m = h_stringmap_get_char(row, table->bclass[c]);
+    if(m == NULL || m->epsilon_branch != loop)
+      return;
+    charset_set(set, c, 1);
+  }
+
+  HLLkSpan *span = h_arena_malloc(table->arena, sizeof(HLLkSpan));
+  h_span_set_init(&span->set, set);
+  span->loop = loop;
+  h_hashtable_put(table->spans, a, span);
+}
+
 /* Generate the LL(k) parse table from the given grammar.
  * Returns -1 on error, 0 on success.
  */
 static int fill_table(size_t kmax, HCFGrammar *g, HLLkTable *table)
 {
   table->start = g->start;
+  memcpy(table->bclass, g->bclass, sizeof(table->bclass));
 
   // iterate over g->nts
   size_t i;
@@ -208,6 +258,8 @@ static int fill_table(size_t kmax, HCFGrammar *g, HLLkTable *table)
         //    delete the whole arena for us.
         return -1;
       }
+
+      fill_span(g, table, a);
     }
   }
   
@@ -257,13 +309,13 @@ void h_llk_free(HParser *parser)
 
 /* LL(k) driver */
 
-HParseResult *h_llk_parse(HAllocator* mm__, const HParser* parser, HInputStream* stream)
+HParseResult *h_llk_parse(HAllocator* mm__, const HParser* parser, HInputStream* stream, HArena *parent)
 {
   const HLLkTable *table = parser->backend_data;
   assert(table != NULL);
 
-  HArena *arena  = h_new_arena(mm__, 0);    // will hold the results
-  HArena *tarena = h_new_arena(mm__, 0);    // tmp, deleted after parse
+  HArena *arena  = parent ? parent : h_new_arena(mm__, 0); // will hold the results
+  HArena *tarena = h_parse_scratch(mm__, parent);           // tmp, given up after parse
   HSlist *stack  = h_slist_new(tarena);
   HCountedArray *seq = h_carray_new(arena); // accumulates current parse result
 
@@ -276,7 +328,8 @@ HParseResult *h_llk_parse(HAllocator* mm__, const HParser* parser, HInputStream*
   // stack below the mark to tell us which validations and semantic actions to
   // execute on their corresponding result.
   // also on the stack below the mark, we store the previously accumulated
-  // value for the surrounding production.
+  // value for the surrounding production, and for a capturing nonterminal
+  // (see h_capture) the input position where it starts.
   void *mark = h_arena_malloc(tarena, 1);
 
   // initialize with the start symbol on the stack.
@@ -292,6 +345,8 @@ HParseResult *h_llk_parse(HAllocator* mm__, const HParser* parser, HInputStream*
       // x is a nonterminal; apply the appropriate production and continue
 
       // push stack frame
+      if(x->capture)
+        h_slist_push(stack, (void *)(uintptr_t)stream->index);
       h_slist_push(stack, seq);   // save current partial value
       h_slist_push(stack, x);     // save the nonterminal
       h_slist_push(stack, mark);  // frame delimiter
@@ -307,6 +362,34 @@ HParseResult *h_llk_parse(HAllocator* mm__, const HParser* parser, HInputStream*
       // an infinite loop case that shouldn't happen
       assert(!p->items[0] || p->items[0] != x);
 
+      // consume a run of a loop's terminal in one go, see HLLkSpan
+      const HLLkSpan *span;
+      if(p->items[0] && p->items[1] == x
+         && (stream->bit_offset & 0x7) == 0
+         && (span = h_hashtable_get(table->spans, x))) {
+        assert(p == span->loop);
+        size_t index = stream->index;
+        size_t n = h_read_span(stream, &span->set);
+        assert(n > 0);
+
+        // x's value is the flat sequence of the run's bytes
+        HParsedToken *toks = h_arena_malloc(arena, n * sizeof(HParsedToken));
+        seq = h_carray_new_sized(arena, n);
+        for(size_t i=0; i<n; i++) {
+          toks[i].token_type = TT_UINT;
+          toks[i].uint = stream->input[index + i];
+          toks[i].index = index + i;
+          toks[i].bit_offset = stream->bit_offset;
+          seq->elements[i] = &toks[i];
+        }
+        seq->used = n;
+
+        // the loop ends with "x -> "; its frame is closed at the mark
+        if(h_llk_lookup(table, x, stream) == NULL)
+          goto no_parse;
+        continue;
+      }
+
       // push production's rhs onto the stack (in reverse order)
       HCFChoice **s;
       for(s = p->items; *s; s++);
@@ -331,6 +414,15 @@ HParseResult *h_llk_parse(HAllocator* mm__, const HParser* parser, HInputStream*
       x   = h_slist_pop(stack);
       seq = h_slist_pop(stack);
       // tok becomes next left-most element of higher-level sequence
+
+      if(x->capture) {
+        // the value is the input the nonterminal covered instead
+        size_t start = (uintptr_t)h_slist_pop(stack);
+        tok->token_type = TT_BYTES;
+        tok->bytes.token = stream->input + start;
+        tok->bytes.len = stream->index - start;
+        tok->index = start;
+      }
     }
     else {
       // x is a terminal or simple charset; match against input
@@ -387,12 +479,13 @@ HParseResult *h_llk_parse(HAllocator* mm__, const HParser* parser, HInputStream*
   // since we started with a single nonterminal on the stack, seq should
   // contain exactly the parse result.
   assert(seq->used == 1);
-  h_delete_arena(tarena);
+  h_parse_scratch_done(parent, tarena);
   return make_result(arena, seq->elements[0]);
 
  no_parse:
-  h_delete_arena(tarena);
-  h_delete_arena(arena);
+  h_parse_scratch_done(parent, tarena);
+  if(!parent)
+    h_delete_arena(arena);
   return NULL;
 }
 
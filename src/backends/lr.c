@@ -1,5 +1,6 @@
 #include <assert.h>
 #include <ctype.h>
+#include <string.h>
 #include "../parsers/parser_internal.h"
 #include "lr.h"
 
@@ -28,53 +29,6 @@ HHashValue h_hash_symbol(const void *p)
     return h_hash_ptr(p);
 }
 
-// compare LR items by value
-static bool eq_lr_item(const void *p, const void *q)
-{
-  const HLRItem *a=p, *b=q;
-
-  if(!h_eq_symbol(a->lhs, b->lhs)) return false;
-  if(a->mark != b->mark) return false;
-  if(a->len != b->len) return false;
-
-  for(size_t i=0; i<a->len; i++)
-    if(!h_eq_symbol(a->rhs[i], b->rhs[i])) return false;
-
-  return true;
-}
-
-// hash LALR items
-static inline HHashValue hash_lr_item(const void *p)
-{
-  const HLRItem *x = p;
-  HHashValue hash = 0;
-
-  hash += h_hash_symbol(x->lhs);
-  for(HCFChoice **p=x->rhs; *p; p++)
-    hash += h_hash_symbol(*p);
-  hash += x->mark;
-
-  return hash;
-}
-
-// compare item sets (DFA states)
-bool h_eq_lr_itemset(const void *p, const void *q)
-{
-  return h_hashset_equal(p, q);
-}
-
-// hash LR item sets (DFA states) - hash the elements and sum
-HHashValue h_hash_lr_itemset(const void *p)
-{
-  HHashValue hash = 0;
-
-  H_FOREACH_KEY((const HHashSet *)p, HLRItem *item)
-    hash += hash_lr_item(item);
-  H_END_FOREACH
-
-  return hash;
-}
-
 bool h_eq_transition(const void *p, const void *q)
 {
   const HLRTransition *a=p, *b=q;
@@ -91,27 +45,6 @@ HHashValue h_hash_transition(const void *p)
 
 /* Constructors */
 
-HLRItem *h_lritem_new(HArena *a, HCFChoice *lhs, HCFChoice **rhs, size_t mark)
-{
-  HLRItem *ret = h_arena_malloc(a, sizeof(HLRItem));
-
-  size_t len = 0;
-  for(HCFChoice **p=rhs; *p; p++) len++;
-  assert(mark <= len);
-
-  ret->lhs = lhs;
-  ret->rhs = rhs;
-  ret->len = len;
-  ret->mark = mark;
-
-  return ret;
-}
-
-HLRState *h_lrstate_new(HArena *arena)
-{
-  return h_hashset_new(arena, eq_lr_item, hash_lr_item);
-}
-
 HLRTable *h_lrtable_new(HAllocator *mm__, size_t nrows)
 {
   HArena *arena = h_new_arena(mm__, 0);    // default blocksize
@@ -122,6 +55,8 @@ HLRTable *h_lrtable_new(HAllocator *mm__, size_t nrows)
   ret->ntmap = h_arena_malloc(arena, nrows * sizeof(HHashTable *));
   ret->tmap = h_arena_malloc(arena, nrows * sizeof(HStringMap *));
   ret->forall = h_arena_malloc(arena, nrows * sizeof(HLRAction *));
+  ret->dense = NULL;
+  ret->span = NULL;
   ret->inadeq = h_slist_new(arena);
   ret->arena = arena;
   ret->mm__ = mm__;
@@ -156,6 +91,7 @@ HLRAction *h_reduce_action(HArena *arena, const HLRItem *item)
   action->type = HLR_REDUCE;
   action->production.lhs = item->lhs;
   action->production.length = item->len;
+  action->production.gotocol = 0;   // assigned by h_lrtable_pack
 #ifndef NDEBUG
   action->production.rhs = item->rhs;
 #endif
@@ -197,6 +133,454 @@ bool h_lrtable_row_empty(const HLRTable *table, size_t i)
 
 
 
+/* Table compression
+ *
+ * The hashtables and string maps of a freshly generated table are convenient
+ * to fill but slow to consult and large. h_lrtable_pack converts them into
+ * the classic compressed representation: input bytes that behave alike in
+ * every state share a column, the most frequent reduction of each row
+ * becomes its default action, and the remaining cells of all rows are
+ * interleaved into a single vector by assigning each row a displacement such
+ * that its cells do not collide with those of other rows. A parallel check
+ * vector records which row owns each cell.
+ */
+
+// copy action into arena, remembering copies so that sharing is preserved
+static const HLRAction *copy_action(HArena *arena, HHashTable *copies,
+                                    const HLRAction *action)
+{
+  if(action == NULL)
+    return NULL;
+
+  HLRAction *copy = h_hashtable_get(copies, action);
+  if(copy)
+    return copy;
+
+  copy = h_arena_malloc(arena, sizeof(HLRAction));
+  *copy = *action;
+  if(action->type == HLR_CONFLICT) {
+    // copy branches, preserving their order
+    size_t n = 0;
+    for(HSlistNode *x=action->branches->head; x; x=x->next)
+      n++;
+    const HLRAction *branches[n];
+    n = 0;
+    for(HSlistNode *x=action->branches->head; x; x=x->next)
+      branches[n++] = copy_action(arena, copies, x->elem);
+    copy->branches = h_slist_new(arena);
+    while(n > 0)
+      h_slist_push(copy->branches, (void *)branches[--n]);
+  }
+  h_hashtable_put(copies, action, copy);
+
+  return copy;
+}
+
+// does the map consist only of (end and) single-character lookaheads?
+static bool lookahead_depth1(const HStringMap *tmap)
+{
+  if(tmap->epsilon_branch)
+    return false;
+  H_FOREACH_VALUE(tmap->char_branches, HStringMap *m)
+    if(!m->epsilon_branch || m->end_branch
+       || !h_hashtable_empty(m->char_branches))
+      return false;
+  H_END_FOREACH
+  return true;
+}
+
+// fill row[c] with the action for lookahead character c
+static void lookahead_row(const HStringMap *tmap, const HLRAction *row[256])
+{
+  memset(row, 0, 256 * sizeof(HLRAction *));
+  H_FOREACH(tmap->char_branches, void *key, HStringMap *m)
+    row[key_char((HCharKey)key)] = m->epsilon_branch;
+  H_END_FOREACH
+}
+
+// state for filling an HLRComb
+typedef struct {
+  HLRComb *comb;
+  size_t len;     // current length of comb's vectors
+  bool *used;     // which slots are occupied
+  size_t free;    // all slots below this one are occupied
+  HArena *arena;  // holds the vectors during construction
+} CombBuilder;
+
+// place the cells of one row into the comb, choosing the lowest free base.
+// cells is indexed by column.
+static void comb_place(CombBuilder *cb, size_t row,
+                       const HLRAction **cells, size_t ncols)
+{
+  HLRComb *comb = cb->comb;
+
+  size_t first = ncols;
+  for(size_t j=0; j<ncols; j++) {
+    if(cells[j]) {
+      first = j;
+      break;
+    }
+  }
+  if(first == ncols) {          // empty row
+    comb->base[row] = HLR_NOROW;
+    return;
+  }
+
+  // first-fit search, starting where the first cell hits a free slot
+  size_t base = (cb->free > first)? cb->free - first : 0;
+  for(;; base++) {
+    size_t j;
+    for(j=first; j<ncols; j++)
+      if(cells[j] && base+j < cb->len && cb->used[base+j])
+        break;
+    if(j == ncols)
+      break;
+  }
+  comb->base[row] = base;
+
+  // grow the vectors as necessary; the end of the vector is padded so that
+  // base+col is always a valid index.
+  if(base + ncols > cb->len) {
+    size_t len = cb->len * 2;
+    if(len < base + ncols)
+      len = base + ncols;
+    const HLRAction **action = h_arena_malloc(cb->arena, len * sizeof(HLRAction *));
+    size_t *check = h_arena_malloc(cb->arena, len * sizeof(size_t));
+    bool *used = h_arena_malloc(cb->arena, len * sizeof(bool));
+    if(cb->len > 0) {
+      memcpy(action, comb->action, cb->len * sizeof(HLRAction *));
+      memcpy(check, comb->check, cb->len * sizeof(size_t));
+      memcpy(used, cb->used, cb->len * sizeof(bool));
+    }
+    for(size_t i=cb->len; i<len; i++) {
+      action[i] = NULL;
+      check[i] = HLR_NOROW;
+      used[i] = false;
+    }
+    comb->action = action;
+    comb->check = check;
+    cb->used = used;
+    cb->len = len;
+  }
+
+  for(size_t j=first; j<ncols; j++) {
+    if(cells[j]) {
+      comb->action[base+j] = cells[j];
+      comb->check[base+j] = row;
+      cb->used[base+j] = true;
+    }
+  }
+  while(cb->free < cb->len && cb->used[cb->free])
+    cb->free++;
+}
+
+// move the vectors of a finished comb into arena, trimmed to size
+static void comb_finish(HArena *arena, CombBuilder *cb)
+{
+  HLRComb *comb = cb->comb;
+  const HLRAction **action = h_arena_malloc(arena, cb->len * sizeof(HLRAction *));
+  size_t *check = h_arena_malloc(arena, cb->len * sizeof(size_t));
+  if(cb->len > 0) {
+    memcpy(action, comb->action, cb->len * sizeof(HLRAction *));
+    memcpy(check, comb->check, cb->len * sizeof(size_t));
+  }
+  comb->action = action;
+  comb->check = check;
+}
+
+// pick the most frequent (non-accepting) reduction among cells
+static const HLRAction *default_action(const HLRTable *table,
+                                       const HLRAction **cells, size_t ncols)
+{
+  const HLRAction *best = NULL;
+  size_t bestcount = 0;
+
+  for(size_t j=0; j<ncols; j++) {
+    const HLRAction *a = cells[j];
+    if(!a || a->type != HLR_REDUCE || a == best)
+      continue;
+    // reducing the start symbol means accepting the input; doing that by
+    // default would accept trailing garbage.
+    if(a->production.lhs == table->start)
+      continue;
+    size_t count = 0;
+    for(size_t i=j; i<ncols; i++)
+      if(cells[i] == a)
+        count++;
+    if(count > bestcount) {
+      best = a;
+      bestcount = count;
+    }
+  }
+
+  return best;
+}
+
+// replace table's hashtables by their packed form.
+// tables with lookahead of more than one character are left untouched.
+void h_lrtable_pack(HLRTable *table)
+{
+  HAllocator *mm__ = table->mm__;
+  size_t nrows = table->nrows;
+
+  for(size_t i=0; i<nrows; i++) {
+    if(!lookahead_depth1(table->tmap[i]))
+      return;
+    if(table->forall[i] && !h_lrtable_row_empty(table, i))
+      return;   // unresolved LR(0) conflict
+  }
+
+  HArena *arena = h_new_arena(mm__, 0);     // new home of the table
+  HArena *tarena = h_new_arena(mm__, 0);    // tmp, deleted after packing
+  HHashTable *copies = h_hashtable_new(tarena, h_eq_ptr, h_hash_ptr);
+  HLRDense *dense = h_arena_malloc(arena, sizeof(HLRDense));
+  const HLRAction *row[256];
+
+  // determine terminal columns, one per byte class
+  uint8_t rep[256];         // the representative byte of each column
+  size_t ncls = 0;
+  for(unsigned int c=0; c<256; c++) {
+    if(h_byteclass_rep(table->bclass, c)) {
+      dense->tcol[c] = ncls;
+      rep[ncls++] = c;
+    } else {
+      // NB: representatives are the smallest members of their classes
+      dense->tcol[c] = dense->tcol[table->bclass[c]];
+    }
+  }
+  dense->ntcols = ncls + 1;
+  size_t endcol = ncls;
+
+  // determine nonterminal columns
+  HHashTable *gotocol = h_hashtable_new(tarena, h_eq_ptr, h_hash_ptr);
+  size_t ngotocols = 0;
+  for(size_t i=0; i<nrows; i++) {
+    H_FOREACH_KEY(table->ntmap[i], HCFChoice *symbol)
+      if(!h_hashtable_present(gotocol, symbol))
+        h_hashtable_put(gotocol, symbol, (void *)(uintptr_t)++ngotocols);
+    H_END_FOREACH
+  }
+  dense->ngotocols = ngotocols;
+  dense->gotosym = h_arena_malloc(arena, (ngotocols+1) * sizeof(HCFChoice *));
+  H_FOREACH(gotocol, HCFChoice *symbol, void *col)
+    dense->gotosym[(uintptr_t)col - 1] = symbol;
+  H_END_FOREACH
+
+  // fill the comb vectors
+  CombBuilder tcb = {&dense->terminals, 0, NULL, 0, tarena};
+  CombBuilder gcb = {&dense->gotos, 0, NULL, 0, tarena};
+  dense->dflt = h_arena_malloc(arena, nrows * sizeof(HLRAction *));
+  dense->terminals.base = h_arena_malloc(arena, nrows * sizeof(size_t));
+  dense->terminals.action = NULL;
+  dense->terminals.check = NULL;
+  dense->gotos.base = h_arena_malloc(arena, nrows * sizeof(size_t));
+  dense->gotos.action = NULL;
+  dense->gotos.check = NULL;
+
+  const HLRAction *cells[ncls+1 > ngotocols ? ncls+1 : ngotocols];
+  for(size_t i=0; i<nrows; i++) {
+    // terminals
+    lookahead_row(table->tmap[i], row);
+    for(size_t j=0; j<ncls; j++)
+      cells[j] = copy_action(arena, copies, row[rep[j]]);
+    cells[endcol] = copy_action(arena, copies, table->tmap[i]->end_branch);
+
+    const HLRAction *dflt = copy_action(arena, copies, table->forall[i]);
+    if(!dflt)
+      dflt = default_action(table, cells, ncls+1);
+    dense->dflt[i] = dflt;
+    for(size_t j=0; j<ncls+1; j++)
+      if(cells[j] == dflt)
+        cells[j] = NULL;
+
+    comb_place(&tcb, i, cells, ncls+1);
+
+    // nonterminals
+    for(size_t j=0; j<ngotocols; j++)
+      cells[j] = NULL;
+    H_FOREACH(table->ntmap[i], HCFChoice *symbol, HLRAction *action)
+      size_t col = (uintptr_t)h_hashtable_get(gotocol, symbol) - 1;
+      cells[col] = copy_action(arena, copies, action);
+    H_END_FOREACH
+
+    comb_place(&gcb, i, cells, ngotocols);
+  }
+
+  // move the vectors from tarena to their final size in arena
+  comb_finish(arena, &tcb);
+  comb_finish(arena, &gcb);
+
+  // record the goto column of each reduction's left-hand side
+  H_FOREACH_VALUE(copies, HLRAction *copy)
+    if(copy->type == HLR_REDUCE) {
+      void *col = h_hashtable_get(gotocol, copy->production.lhs);
+      assert(col != NULL);
+      copy->production.gotocol = (uintptr_t)col - 1;
+    }
+  H_END_FOREACH
+
+  // carry over the list of inadequate states
+  HSlist *inadeq = h_slist_new(arena);
+  for(HSlistNode *x=table->inadeq->head; x; x=x->next)
+    h_slist_push(inadeq, x->elem);
+
+  // switch the table over to its packed form
+  h_delete_arena(tarena);
+  h_delete_arena(table->arena);
+  table->arena = arena;
+  table->ntmap = NULL;
+  table->tmap = NULL;
+  table->forall = NULL;
+  table->inadeq = inadeq;
+  table->dense = dense;
+}
+
+
+
+/* Span shifting
+ *
+ * Repetitions of a terminal, like h_many(h_ch_range(...)) or the leading
+ * space of h_whitespace, desugar to a loop nonterminal x -> t x | "" (see
+ * h_span_terminal). The state whose only kernel item is "x -> t . x" returns
+ * to itself on every byte of t, reduces "x -> " otherwise, and the state
+ * reached from there only reduces "x -> t x". Upon entering such a state, the
+ * driver consumes the whole run of t at once and directly performs the
+ * reductions that would follow, giving x the flat sequence of the bytes as its
+ * value.
+ */
+
+// look up the action for a single byte of lookahead, NULL meaning end of input
+static const HLRAction *byte_action(const HLRTable *table, size_t state,
+                                    const uint8_t *c)
+{
+  HInputStream lookahead = {
+    .input = c,
+    .index = 0,
+    .length = c? 1 : 0,
+    .bit_offset = 8,
+    .endianness = BIT_BIG_ENDIAN | BYTE_BIG_ENDIAN,
+    .overrun = 0
+  };
+  return h_lrtable_action(table, state, &lookahead);
+}
+
+static bool is_reduce(const HLRAction *action, const HCFChoice *lhs, size_t len)
+{
+  return (action->type == HLR_REDUCE
+          && action->production.lhs == lhs
+          && action->production.length == len);
+}
+
+// does the given action in state i, on a byte of t, lead straight back to i?
+// a charset t is a nonterminal here; its byte is shifted and then reduced.
+static bool loops_back(const HLRTable *table, size_t i, const HCFChoice *t,
+                       const HLRAction *action)
+{
+  if(!action || action->type != HLR_SHIFT)
+    return false;
+  if(t->type == HCF_CHAR)
+    return (action->nextstate == i);
+
+  size_t r = action->nextstate;
+  const HLRAction *reduce = byte_action(table, r, NULL);
+  for(unsigned int c=0; c<256; c++) {
+    uint8_t b = c;
+    const HLRAction *a = byte_action(table, r, &b);
+    if(!a || !is_reduce(a, t, 1))
+      return false;
+    reduce = a;
+  }
+  if(!reduce || !is_reduce(reduce, t, 1))
+    return false;
+  const HLRAction *shift = h_lrtable_goto(table, i, reduce);
+  return (shift && shift->nextstate == i);
+}
+
+// can state i consume a run in one step? return the HLRSpan if so.
+static const HLRSpan *make_span(HLRTable *table, HCFGrammar *g,
+                                const HLRDFA *dfa, size_t i)
+{
+  const HLRState *state = dfa->states[i];
+  if(state->nkernel != 1)
+    return NULL;
+  const HLRItem *item = state->items[0];
+  if(item->len != 2 || item->mark != 1 || item->rhs[1] != item->lhs)
+    return NULL;
+  const HCFChoice *x = item->lhs;
+  const HCFChoice *t = h_span_terminal(g, x);
+  if(t == NULL)
+    return NULL;
+
+  // every byte of t shifts back to i, anything else reduces "x -> " or fails
+  HCharset set = h_arena_malloc(table->arena, 256);
+  memset(set, 0, 256);
+  const HLRAction *empty = byte_action(table, i, NULL);
+  if(empty && !is_reduce(empty, x, 0))
+    return NULL;
+  for(unsigned int c=0; c<256; c++) {
+    uint8_t b = c;
+    const HLRAction *action = byte_action(table, i, &b);
+    if(t->type == HCF_CHAR? c == t->chr : charset_isset(t->charset, c)) {
+      if(!loops_back(table, i, t, action))
+        return NULL;
+      charset_set(set, c, 1);
+    } else if(action) {
+      if(!is_reduce(action, x, 0))
+        return NULL;
+      empty = action;
+    }
+  }
+  if(empty == NULL)
+    return NULL;    // the loop can never end
+
+  // after "x -> ", only "x -> t x" is reduced
+  const HLRAction *shift = h_lrtable_goto(table, i, empty);
+  if(shift == NULL)
+    return NULL;
+  size_t reduced = shift->nextstate;
+  const HLRAction *action = byte_action(table, reduced, NULL);
+  if(action && !is_reduce(action, x, 2))
+    return NULL;
+  for(unsigned int c=0; c<256; c++) {
+    uint8_t b = c;
+    action = byte_action(table, reduced, &b);
+    if(action && !is_reduce(action, x, 2))
+      return NULL;
+  }
+
+  HLRSpan *span = h_arena_malloc(table->arena, sizeof(HLRSpan));
+  h_span_set_init(&span->set, set);
+  span->reduced = reduced;
+  return span;
+}
+
+// find the states of the table that can consume a run in one step.
+// dfa must be the LR(0) automaton of g that the table was generated from.
+void h_lrtable_spans(HLRTable *table, HCFGrammar *g, const HLRDFA *dfa)
+{
+  assert(dfa->nstates == table->nrows);
+
+  const HLRSpan **span = h_arena_malloc(table->arena,
+                                        table->nrows * sizeof(HLRSpan *));
+  bool any = false;
+  for(size_t i=0; i<table->nrows; i++) {
+    span[i] = make_span(table, g, dfa, i);
+    if(span[i])
+      any = true;
+  }
+
+  table->span = any? span : NULL;
+}
+
+static inline const HLRAction *
+comb_get(const HLRComb *comb, size_t row, size_t col)
+{
+  size_t i = comb->base[row] + col;
+  return (comb->check[i] == row)? comb->action[i] : NULL;
+}
+
+
+
 /* LR driver */
 
 HLREngine *h_lrengine_new(HArena *arena, HArena *tarena, const HLRTable *table,
@@ -206,70 +590,209 @@ HLREngine *h_lrengine_new(HArena *arena, HArena *tarena, const HLRTable *table,
 
   engine->table = table;
   engine->state = 0;
-  engine->stack = h_slist_new(tarena);
+  engine->capacity = 64;
+  engine->stack = h_arena_malloc(tarena, engine->capacity * sizeof(HLRStackEntry));
+  engine->depth = 0;
   engine->input = *stream;
-  engine->merged[0] = NULL;
-  engine->merged[1] = NULL;
   engine->arena = arena;
   engine->tarena = tarena;
 
   return engine;
 }
 
-static const HLRAction *
-terminal_lookup(const HLREngine *engine, const HInputStream *stream)
+// lookup the action for the given lookahead in the given state
+const HLRAction *h_lrtable_action(const HLRTable *table, size_t state,
+                                  const HInputStream *stream)
 {
-  const HLRTable *table = engine->table;
-  size_t state = engine->state;
-
   assert(state < table->nrows);
-  if(table->forall[state]) {
+  if(table->dense) {
+    const HLRDense *dense = table->dense;
+    const HLRAction *action = NULL;
+
+    if(dense->terminals.base[state] != HLR_NOROW) {
+      // note the lookahead stream is passed by value, i.e. a copy.
+      HInputStream lookahead = *stream;
+      uint8_t c = h_read_bits(&lookahead, 8, false);
+      size_t col = lookahead.overrun? dense->ntcols-1 : dense->tcol[c];
+      action = comb_get(&dense->terminals, state, col);
+    }
+
+    return action? action : dense->dflt[state];
+  } else if(table->forall[state]) {
     assert(h_lrtable_row_empty(table, state));  // that would be a conflict
     return table->forall[state];
   } else {
-    return h_stringmap_get_lookahead(table->tmap[state], *stream);
+    return h_stringmap_get_lookahead(table->tmap[state], table->bclass, *stream);
   }
 }
 
-static const HLRAction *
-nonterminal_lookup(const HLREngine *engine, const HCFChoice *symbol)
+// look up the goto entry for the lhs of the given reduction
+// lookup the shift (goto) following the given reduction in the given state
+const HLRAction *h_lrtable_goto(const HLRTable *table, size_t state,
+                                const HLRAction *reduce)
 {
-  const HLRTable *table = engine->table;
-  size_t state = engine->state;
-
   assert(state < table->nrows);
+  if(table->dense) {
+    const HLRComb *gotos = &table->dense->gotos;
+    if(gotos->base[state] == HLR_NOROW)
+      return NULL;
+    return comb_get(gotos, state, reduce->production.gotocol);
+  }
+
   assert(!table->forall[state]);    // contains only reduce entries
                                     // we are only looking for shifts
-  return h_hashtable_get(table->ntmap[state], symbol);
+  return h_hashtable_get(table->ntmap[state], reduce->production.lhs);
 }
 
 const HLRAction *h_lrengine_action(const HLREngine *engine)
 {
-  return terminal_lookup(engine, &engine->input);
+  return h_lrtable_action(engine->table, engine->state, &engine->input);
 }
 
-static HParsedToken *consume_input(HLREngine *engine)
+// read one token from the input; yields NULL at the end of input
+HParsedToken *h_lr_consume_input(HArena *arena, HInputStream *input)
 {
   HParsedToken *v;
+  size_t index = input->index;
+  char bit_offset = input->bit_offset;
 
-  uint8_t c = h_read_bits(&engine->input, 8, false);
+  uint8_t c = h_read_bits(input, 8, false);
 
-  if(engine->input.overrun) {     // end of input
+  if(input->overrun) {     // end of input
     v = NULL;
   } else {
-    v = h_arena_malloc(engine->arena, sizeof(HParsedToken));
+    v = h_arena_malloc(arena, sizeof(HParsedToken));
     v->token_type = TT_UINT;
     v->uint = c;
+    v->index = index;
+    v->bit_offset = bit_offset;
   }
 
   return v;
 }
 
+// compute the semantic value of a reduction from the values of its right-hand
+// side, given in 'seq'. the reduction covers input[start..end). returns false
+// if validation fails.
+bool h_lr_reduce_value(HArena *arena, HArena *tarena, const HLRAction *action,
+                       HCountedArray *seq, const uint8_t *input,
+                       size_t start, size_t end, HParsedToken **result)
+{
+  HCFChoice *symbol = action->production.lhs;
+
+  HParsedToken *value = h_arena_malloc(arena, sizeof(HParsedToken));
+  if(symbol->capture) {
+    // the input itself, see h_capture
+    value->token_type = TT_BYTES;
+    value->bytes.token = input + start;
+    value->bytes.len = end - start;
+  } else {
+    value->token_type = TT_SEQUENCE;
+    value->seq = seq;
+  }
+
+  HParsedToken *v = seq->used > 0 ? seq->elements[0] : NULL;
+  if(v) {
+    // result position equals position of left-most symbol
+    value->index = v->index;
+    value->bit_offset = v->bit_offset;
+  } else {
+    value->index = start;
+    value->bit_offset = 0;
+  }
+
+  // perform token reshape if indicated
+  if(symbol->reshape)
+    value = (HParsedToken *)symbol->reshape(make_result(arena, value), symbol->user_data);
+
+  // call validation and semantic action, if present
+  if(symbol->pred && !symbol->pred(make_result(tarena, value), symbol->user_data))
+    return false;
+  if(symbol->action)
+    value = (HParsedToken *)symbol->action(make_result(arena, value), symbol->user_data);
+
+  *result = value;
+  return true;
+}
+
+// push the current state and the given value, of a symbol starting at index,
+// onto the stack
+static void stack_push(HLREngine *engine, HParsedToken *value, size_t index)
+{
+  if(engine->depth == engine->capacity) {
+    // grow geometrically; the old array stays in the arena until the end
+    size_t n = engine->capacity * 2;
+    HLRStackEntry *stack = h_arena_malloc(engine->tarena, n * sizeof(HLRStackEntry));
+    memcpy(stack, engine->stack, engine->depth * sizeof(HLRStackEntry));
+    h_arena_free(engine->tarena, engine->stack);
+    engine->stack = stack;
+    engine->capacity = n;
+  }
+
+  HLRStackEntry *top = &engine->stack[engine->depth++];
+  top->state = engine->state;
+  top->value = value;
+  top->index = index;
+}
+
+// the top of the stack holds the first byte of a run in a span state;
+// consume the rest of the run and reduce it. see h_lrtable_spans.
+static bool lrengine_span(HLREngine *engine, const HLRSpan *span)
+{
+  const HLRTable *table = engine->table;
+  HArena *arena = engine->arena;
+  HInputStream *input = &engine->input;
+  HParsedToken *first = engine->stack[engine->depth-1].value;
+  size_t start = engine->stack[engine->depth-1].index;
+
+  size_t index = input->index;
+  size_t n = h_read_span(input, &span->set);
+
+  // the run must be followed by the reductions "x -> " and "x -> t x"
+  if(h_lrtable_action(table, engine->state, input) == NULL)
+    return false;
+  const HLRAction *reduce = h_lrtable_action(table, span->reduced, input);
+  if(reduce == NULL)
+    return false;
+
+  // x's value is the flat sequence of the run's bytes
+  HCountedArray *seq = h_carray_new_sized(arena, n+1);
+  seq->elements[0] = first;
+  if(n > 0) {
+    HParsedToken *toks = h_arena_malloc(arena, n * sizeof(HParsedToken));
+    for(size_t i=0; i<n; i++) {
+      toks[i].token_type = TT_UINT;
+      toks[i].uint = input->input[index + i];
+      toks[i].index = index + i;
+      toks[i].bit_offset = input->bit_offset;
+      seq->elements[i+1] = &toks[i];
+    }
+  }
+  seq->used = n+1;
+
+  HParsedToken *value = h_arena_malloc(arena, sizeof(HParsedToken));
+  value->token_type = TT_SEQUENCE;
+  value->seq = seq;
+  value->index = first->index;
+  value->bit_offset = first->bit_offset;
+
+  // replace the first byte on the stack by x
+  engine->depth--;
+  engine->state = engine->stack[engine->depth].state;
+  const HLRAction *shift = h_lrtable_goto(table, engine->state, reduce);
+  if(shift == NULL)
+    return false;     // parse error
+  assert(shift->type == HLR_SHIFT);
+  stack_push(engine, value, start);
+  engine->state = shift->nextstate;
+
+  return true;
+}
+
 // run LR parser for one round; returns false when finished
 bool h_lrengine_step(HLREngine *engine, const HLRAction *action)
 {
   // short-hand names
-  HSlist *stack = engine->stack;
   HArena *arena = engine->arena;
   HArena *tarena = engine->tarena;
 
@@ -281,51 +804,39 @@ bool h_lrengine_step(HLREngine *engine, const HLRAction *action)
   if(action->type == HLR_REDUCE) {
     size_t len = action->production.length;
     HCFChoice *symbol = action->production.lhs;
+    HCountedArray *seq = h_carray_new_sized(arena, len);
 
-    // semantic value of the reduction result
-    HParsedToken *value = h_arena_malloc(arena, sizeof(HParsedToken));
-    value->token_type = TT_SEQUENCE;
-    value->seq = h_carray_new_sized(arena, len);
-    
     // pull values off the stack, rewinding state accordingly
-    HParsedToken *v = NULL;
-    for(size_t i=0; i<len; i++) {
-      v = h_slist_drop(stack);
-      engine->state = (uintptr_t)h_slist_drop(stack);
+    assert(engine->depth >= len);
+    size_t start = engine->input.index;
+    if(len > 0) {
+      const HLRStackEntry *base = &engine->stack[engine->depth - len];
+      engine->state = base->state;
+      engine->depth -= len;
+      start = base->index;
 
       // collect values in result sequence
-      value->seq->elements[len-1-i] = v;
-      value->seq->used++;
-    }
-    if(v) {
-      // result position equals position of left-most symbol
-      value->index = v->index;
-      value->bit_offset = v->bit_offset;
-    } else {
-      // XXX how to get the position in this case?
+      for(size_t i=0; i<len; i++)
+        seq->elements[i] = base[i].value;
+      seq->used = len;
     }
 
-    // perform token reshape if indicated
-    if(symbol->reshape)
-      value = (HParsedToken *)symbol->reshape(make_result(arena, value), symbol->user_data);
-
-    // call validation and semantic action, if present
-    if(symbol->pred && !symbol->pred(make_result(tarena, value), symbol->user_data))
+    // semantic value of the reduction result
+    HParsedToken *value;
+    if(!h_lr_reduce_value(arena, tarena, action, seq, engine->input.input,
+                          start, engine->input.index, &value))
       return false;     // validation failed -> no parse; terminate
-    if(symbol->action)
-      value = (HParsedToken *)symbol->action(make_result(arena, value), symbol->user_data);
 
     // this is LR, building a right-most derivation bottom-up, so no reduce can
     // follow a reduce. we can also assume no conflict follows for GLR if we
     // use LALR tables, because only terminal symbols (lookahead) get reduces.
-    const HLRAction *shift = nonterminal_lookup(engine, symbol);
+    const HLRAction *shift = h_lrtable_goto(engine->table, engine->state, action);
     if(shift == NULL)
       return false;     // parse error
     assert(shift->type == HLR_SHIFT);
 
     // piggy-back the shift right here, never touching the input
-    h_slist_push(stack, (void *)(uintptr_t)engine->state);
-    h_slist_push(stack, value);
+    stack_push(engine, value, start);
     engine->state = shift->nextstate;
 
     // check for success
@@ -335,12 +846,18 @@ bool h_lrengine_step(HLREngine *engine, const HLRAction *action)
     }
   } else {
     assert(action->type == HLR_SHIFT);
-    HParsedToken *value = consume_input(engine);
-    h_slist_push(stack, (void *)(uintptr_t)engine->state);
-    h_slist_push(stack, value);
+    size_t start = engine->input.index;
+    HParsedToken *value = h_lr_consume_input(arena, &engine->input);
+    stack_push(engine, value, start);
     engine->state = action->nextstate;
   }
 
+  // entering a loop on a terminal, take the rest of the run right away
+  const HLRTable *table = engine->table;
+  if(table->span && table->span[engine->state]
+     && (engine->input.bit_offset & 0x7) == 0)
+    return lrengine_span(engine, table->span[engine->state]);
+
   return true;
 }
 
@@ -349,31 +866,31 @@ HParseResult *h_lrengine_result(HLREngine *engine)
   // parsing was successful iff the engine reaches the end state
   if(engine->state == HLR_SUCCESS) {
     // on top of the stack is the start symbol's semantic value
-    assert(!h_slist_empty(engine->stack));
-    HParsedToken *tok = engine->stack->head->elem;
+    assert(engine->depth > 0);
+    HParsedToken *tok = engine->stack[engine->depth-1].value;
     return make_result(engine->arena, tok);
   } else {
     return NULL;
   }
 }
 
-HParseResult *h_lr_parse(HAllocator* mm__, const HParser* parser, HInputStream* stream)
+HParseResult *h_lr_parse(HAllocator* mm__, const HParser* parser, HInputStream* stream, HArena *parent)
 {
   HLRTable *table = parser->backend_data;
   if(!table)
     return NULL;
 
-  HArena *arena  = h_new_arena(mm__, 0);    // will hold the results
-  HArena *tarena = h_new_arena(mm__, 0);    // tmp, deleted after parse
+  HArena *arena  = parent ? parent : h_new_arena(mm__, 0); // will hold the results
+  HArena *tarena = h_parse_scratch(mm__, parent);           // tmp, given up after parse
   HLREngine *engine = h_lrengine_new(arena, tarena, table, stream);
 
   // iterate engine to completion
   while(h_lrengine_step(engine, h_lrengine_action(engine)));
 
   HParseResult *result = h_lrengine_result(engine);
-  if(!result)
+  if(!result && !parent)
     h_delete_arena(arena);
-  h_delete_arena(tarena);
+  h_parse_scratch_done(parent, tarena);
   return result;
 }
 
@@ -422,14 +939,21 @@ void h_pprint_lritem(FILE *f, const HCFGrammar *g, const HLRItem *item)
 void h_pprint_lrstate(FILE *f, const HCFGrammar *g,
                       const HLRState *state, unsigned int indent)
 {
-  bool first = true;
-  H_FOREACH_KEY(state, HLRItem *item)
-    if(!first)
+  for(size_t j=0; j<state->nitems; j++) {
+    if(j > 0)
       for(unsigned int i=0; i<indent; i++) fputc(' ', f);
-    first = false;
-    h_pprint_lritem(f, g, item);
+    h_pprint_lritem(f, g, state->items[j]);
+    if(state->lookahead) {
+      fputs(", {", f);
+      for(unsigned int c=0; c<256; c++)
+        if(tset_member(&state->lookahead[j], c))
+          h_pprint_char(f, c);
+      if(tset_member(&state->lookahead[j], TSET_END))
+        fputc('$', f);
+      fputc('}', f);
+    }
     fputc('\n', f);
-  H_END_FOREACH
+  }
 }
 
 static void pprint_transition(FILE *f, const HCFGrammar *g, const HLRTransition *t)
@@ -505,9 +1029,55 @@ static void pprint_lrtable_terminals(FILE *file, const HCFGrammar *g,
   h_pprint_stringmap(file, ' ', valprint_lraction, (void *)g, map);
 }
 
+static void pprint_lrtable_dense(FILE *f, const HCFGrammar *g,
+                                 const HLRTable *table, unsigned int indent)
+{
+  const HLRDense *dense = table->dense;
+
+  for(size_t i=0; i<table->nrows; i++) {
+    for(unsigned int j=0; j<indent; j++) fputc(' ', f);
+    fprintf(f, "%4zu:", i);
+    if(dense->dflt[i]) {
+      fputc(' ', f);
+      pprint_lraction(f, g, dense->dflt[i]);
+    }
+    if(dense->gotos.base[i] != HLR_NOROW) {
+      for(size_t col=0; col<dense->ngotocols; col++) {
+        const HLRAction *action = comb_get(&dense->gotos, i, col);
+        if(!action) continue;
+        fputc(' ', f);    // separator
+        h_pprint_symbol(f, g, dense->gotosym[col]);
+        fputc(':', f);
+        pprint_lraction(f, g, action);
+      }
+    }
+    if(dense->terminals.base[i] != HLR_NOROW) {
+      for(unsigned int c=0; c<256; c++) {
+        const HLRAction *action = comb_get(&dense->terminals, i, dense->tcol[c]);
+        if(!action) continue;
+        fputs(" \"", f);  // separator
+        h_pprint_char(f, c);
+        fputs("\":", f);
+        pprint_lraction(f, g, action);
+      }
+      const HLRAction *action = comb_get(&dense->terminals, i, dense->ntcols-1);
+      if(action) {
+        fputs(" $:", f);
+        pprint_lraction(f, g, action);
+      }
+    }
+    fputc('\n', f);
+  }
+}
+
 void h_pprint_lrtable(FILE *f, const HCFGrammar *g, const HLRTable *table,
                       unsigned int indent)
 {
+  if(table->dense) {
+    pprint_lrtable_dense(f, g, table, indent);
+    return;
+  }
+
   for(size_t i=0; i<table->nrows; i++) {
     for(unsigned int j=0; j<indent; j++) fputc(' ', f);
     fprintf(f, "%4zu:", i);
@@ -6,7 +6,48 @@
 #include "../internal.h"
 
 
-typedef HHashSet HLRState;  // states are sets of LRItems
+// terminal sets: one bit per byte, plus one for the end of input
+#define TSET_END 256
+#define TSET_WORDS ((256 + 1 + 63) / 64)
+typedef struct HLRTermSet_ {
+  uint64_t w[TSET_WORDS];
+} HLRTermSet;
+
+static inline void tset_add(HLRTermSet *s, size_t t)
+{
+  s->w[t/64] |= (uint64_t)1 << (t%64);
+}
+
+static inline void tset_del(HLRTermSet *s, size_t t)
+{
+  s->w[t/64] &= ~((uint64_t)1 << (t%64));
+}
+
+static inline bool tset_member(const HLRTermSet *s, size_t t)
+{
+  return (s->w[t/64] >> (t%64)) & 1;
+}
+
+static inline void tset_union(HLRTermSet *s, const HLRTermSet *t)
+{
+  for(size_t i=0; i<TSET_WORDS; i++)
+    s->w[i] |= t->w[i];
+}
+
+typedef struct HLRItem_ {
+  HCFChoice *lhs;
+  HCFChoice **rhs;          // NULL-terminated
+  size_t len;               // number of elements in rhs
+  size_t mark;
+} HLRItem;
+
+// items are interned (see h_lr0_dfa), so they can be compared by pointer
+typedef struct HLRState_ {
+  size_t nkernel;           // number of kernel items, stored first
+  size_t nitems;            // number of items in the closure
+  const HLRItem **items;    // array of size nitems
+  const HLRTermSet *lookahead;  // per item, in LR(1) automata (else NULL)
+} HLRState;
 
 typedef struct HLRDFA_ {
   size_t nstates;
@@ -20,13 +61,6 @@ typedef struct HLRTransition_ {
   size_t to;                // index into 'states' array
 } HLRTransition;
 
-typedef struct HLRItem_ {
-  HCFChoice *lhs;
-  HCFChoice **rhs;          // NULL-terminated
-  size_t len;               // number of elements in rhs
-  size_t mark;
-} HLRItem;
-
 typedef struct HLRAction_ {
   enum {HLR_SHIFT, HLR_REDUCE, HLR_CONFLICT} type;
   union {
@@ -37,6 +71,7 @@ typedef struct HLRAction_ {
     struct {
       HCFChoice *lhs;   // symbol carrying semantic actions etc.
       size_t length;    // # of symbols in rhs
+      size_t gotocol;   // column of lhs in a packed table's gotos
 #ifndef NDEBUG
       HCFChoice **rhs;  // NB: the rhs symbols are not needed for the parse
 #endif
@@ -47,34 +82,60 @@ typedef struct HLRAction_ {
   };
 } HLRAction;
 
+// row-displaced ("comb") vector holding the cells of all rows of a table
+typedef struct HLRComb_ {
+  size_t *base;             // per row, offset of column 0 (or HLR_NOROW)
+  const HLRAction **action; // cells, interleaved
+  size_t *check;            // index of the row owning each cell
+} HLRComb;
+
+#define HLR_NOROW ((size_t)~0)      // base of a row without any cells
+
+typedef struct HLRDense_ {
+  uint8_t    tcol[256]; // map input bytes to terminal columns (byte classes)
+  size_t     ntcols;    // # of terminal columns; last one is end of input
+  size_t     ngotocols; // # of nonterminal columns
+  const HCFChoice **gotosym;  // nonterminal symbol of each goto column
+  const HLRAction **dflt;     // per row, action if no cell matches (or NULL)
+  HLRComb    terminals;
+  HLRComb    gotos;
+} HLRDense;
+
+// a state that loops on the bytes of a terminal t, see h_lrtable_spans
+typedef struct HLRSpan_ {
+  HSpanSet   set;       // the bytes of t
+  size_t     reduced;   // state reached by the reduction "x -> "
+} HLRSpan;
+
 typedef struct HLRTable_ {
   size_t     nrows;     // dimension of the pointer arrays below
   HHashTable **ntmap;   // map nonterminal symbols to HLRActions, per row
   HStringMap **tmap;    // map lookahead strings to HLRActions, per row
   HLRAction  **forall;  // shortcut to set an action for an entire row
+  HLRDense   *dense;    // packed form; replaces the above if not NULL
+  const HLRSpan **span; // per row, run to consume in one step (or NULL)
   HCFChoice  *start;    // start symbol
+  uint8_t    bclass[256];   // byte classes of the grammar
   HSlist     *inadeq;   // indices of any inadequate states
   HArena     *arena;
   HAllocator *mm__;
 } HLRTable;
 
-typedef struct HLREnhGrammar_ {
-  HCFGrammar *grammar;  // enhanced grammar
-  HHashTable *tmap;     // maps transitions to enhanced-grammar symbols
-  HHashTable *smap;     // maps enhanced-grammar symbols to transitions
-  HHashTable *corr;     // maps symbols to sets of corresponding e. symbols
-  HArena *arena;
-} HLREnhGrammar;
+typedef struct HLRStackEntry_ {
+  size_t state;         // saved state
+  HParsedToken *value;  // semantic value
+  size_t index;         // input position where the symbol starts
+} HLRStackEntry;
 
 typedef struct HLREngine_ {
   const HLRTable *table;
   size_t state;
 
-  HSlist *stack;        // holds pairs: (saved state, semantic value)
+  HLRStackEntry *stack; // bottom first
+  size_t depth;         // number of entries in use
+  size_t capacity;      // number of entries allocated
   HInputStream input;
 
-  struct HLREngine_ *merged[2]; // ancestors merged into this engine
-
   HArena *arena;        // will hold the results
   HArena *tarena;       // tmp, deleted after parse
 } HLREngine;
@@ -98,6 +159,9 @@ typedef struct HLREngine_ {
 #define H_FOREACH(HT, KEYVAR, VALVAR) H_FOREACH_KEY(HT, KEYVAR)             \
         VALVAR = hte__->value;
 
+#define H_FOREACH_VALUE(HT, VALVAR) H_FOREACH_(HT)                          \
+        VALVAR = hte__->value;
+
 #define H_END_FOREACH                                                       \
       }                                                                     \
     }                                                                       \
@@ -105,8 +169,6 @@ typedef struct HLREngine_ {
 
 
 
-HLRItem *h_lritem_new(HArena *a, HCFChoice *lhs, HCFChoice **rhs, size_t mark);
-HLRState *h_lrstate_new(HArena *arena);
 HLRTable *h_lrtable_new(HAllocator *mm__, size_t nrows);
 void h_lrtable_free(HLRTable *table);
 HLREngine *h_lrengine_new(HArena *arena, HArena *tarena, const HLRTable *table,
@@ -115,26 +177,36 @@ HLRAction *h_reduce_action(HArena *arena, const HLRItem *item);
 HLRAction *h_shift_action(HArena *arena, size_t nextstate);
 HLRAction *h_lr_conflict(HArena *arena, HLRAction *action, HLRAction *new);
 bool h_lrtable_row_empty(const HLRTable *table, size_t i);
+void h_lrtable_pack(HLRTable *table);
+void h_lrtable_spans(HLRTable *table, HCFGrammar *g, const HLRDFA *dfa);
 
 bool h_eq_symbol(const void *p, const void *q);
-bool h_eq_lr_itemset(const void *p, const void *q);
 bool h_eq_transition(const void *p, const void *q);
 HHashValue h_hash_symbol(const void *p);
-HHashValue h_hash_lr_itemset(const void *p);
 HHashValue h_hash_transition(const void *p);
 
 HLRDFA *h_lr0_dfa(HCFGrammar *g);
+HLRDFA *h_lr1_dfa(HCFGrammar *g);
 HLRTable *h_lr0_table(HCFGrammar *g, const HLRDFA *dfa);
 
 HCFChoice *h_desugar_augmented(HAllocator *mm__, HParser *parser);
 int h_lalr_compile(HAllocator* mm__, HParser* parser, const void* params);
 void h_lalr_free(HParser *parser);
 
+const HLRAction *h_lrtable_action(const HLRTable *table, size_t state,
+                                  const HInputStream *stream);
+const HLRAction *h_lrtable_goto(const HLRTable *table, size_t state,
+                                const HLRAction *reduce);
+HParsedToken *h_lr_consume_input(HArena *arena, HInputStream *input);
+bool h_lr_reduce_value(HArena *arena, HArena *tarena, const HLRAction *action,
+                       HCountedArray *seq, const uint8_t *input,
+                       size_t start, size_t end, HParsedToken **result);
+
 const HLRAction *h_lrengine_action(const HLREngine *engine);
 bool h_lrengine_step(HLREngine *engine, const HLRAction *action);
 HParseResult *h_lrengine_result(HLREngine *engine);
-HParseResult *h_lr_parse(HAllocator* mm__, const HParser* parser, HInputStream* stream);
-HParseResult *h_glr_parse(HAllocator* mm__, const HParser* parser, HInputStream* stream);
+HParseResult *h_lr_parse(HAllocator* mm__, const HParser* parser, HInputStream* stream, HArena *parent);
+HParseResult *h_glr_parse(HAllocator* mm__, const HParser* parser, HInputStream* stream, HArena *parent);
 
 void h_pprint_lritem(FILE *f, const HCFGrammar *g, const HLRItem *item);
 void h_pprint_lrstate(FILE *f, const HCFGrammar *g,
@@ -1,157 +1,481 @@
 #include <assert.h>
+#include <stdlib.h>
+#include <string.h>
 #include "lr.h"
 
 
 
-/* Constructing the characteristic automaton (handle recognizer) */
-
-static HLRItem *advance_mark(HArena *arena, const HLRItem *item)
+/* Constructing the characteristic automaton (handle recognizer)
+ *
+ * All LR(0) items of the grammar are enumerated ("interned") up front, such
+ * that the items of each production occupy consecutive ids, ordered by the
+ * position of the mark. Advancing the mark of an item thus increments its id.
+ * A state is identified by its kernel, a sorted array of item ids. The
+ * closure of a kernel is read off precomputed per-nonterminal bitsets of the
+ * nonterminals whose productions it contains.
+ */
+
+// single-character right-hand sides for the productions of charsets
+#define CHR1(n)  {.type = HCF_CHAR, .chr = (n)}
+#define CHR4(n)  CHR1(n), CHR1(n+1), CHR1(n+2), CHR1(n+3)
+#define CHR16(n) CHR4(n), CHR4(n+4), CHR4(n+8), CHR4(n+12)
+#define CHR64(n) CHR16(n), CHR16(n+16), CHR16(n+32), CHR16(n+48)
+static HCFChoice single_chars[256] =
+  {CHR64(0), CHR64(64), CHR64(128), CHR64(192)};
+#define RHS1(n)  {&single_chars[n], NULL}
+#define RHS4(n)  RHS1(n), RHS1(n+1), RHS1(n+2), RHS1(n+3)
+#define RHS16(n) RHS4(n), RHS4(n+4), RHS4(n+8), RHS4(n+12)
+#define RHS64(n) RHS16(n), RHS16(n+16), RHS16(n+32), RHS16(n+48)
+static HCFChoice *single_char_rhs[256][2] =
+  {RHS64(0), RHS64(64), RHS64(128), RHS64(192)};
+
+// symbol ids: characters are their own ids, followed by the end of input and
+// the nonterminals
+#define SYM_END 256
+#define SYM_NT(i) (257 + (i))
+#define NOSYM ((size_t)~0)
+
+typedef struct HLRItems_ {
+  size_t nnts;          // number of nonterminals
+  HCFChoice **nts;      // nonterminal symbols, by index
+  size_t *prods;        // per nonterminal: index of first production
+  size_t *base;         // per production: id of its item with mark 0
+  size_t nitems;
+  HLRItem *items;       // all items, by id
+  size_t *next;         // per item: id of the symbol after the mark (or NOSYM)
+  size_t *lhs;          // per item: index of its lhs nonterminal
+  size_t words;         // size of a nonterminal bitset in words
+  uint64_t *ntclosure;  // per nonterminal: closure bitset of nonterminals
+} HLRItems;
+
+// add x to the index of nonterminals, if not present
+static void add_nt(HHashTable *index, HCFChoice *x, size_t *n)
 {
-  assert(item->rhs[item->mark] != NULL);
-  HLRItem *ret = h_arena_malloc(arena, sizeof(HLRItem));
-  *ret = *item;
-  ret->mark++;
-  return ret;
+  if(x->type != HCF_CHOICE && x->type != HCF_CHARSET)
+    return;
+  if(h_hashtable_present(index, x))
+    return;
+  h_hashtable_put(index, x, (void *)(uintptr_t)(*n)++);
 }
 
-static void expand_to_closure(HCFGrammar *g, HHashSet *items)
+static HLRItems *enumerate_items(HCFGrammar *g)
 {
-  HAllocator *mm__ = g->mm__;
   HArena *arena = g->arena;
-  HSlist *work = h_slist_new(arena);
-
-  // initialize work list with items
-  H_FOREACH_KEY(items, HLRItem *item)
-    h_slist_push(work, (void *)item);
+  HLRItems *it = h_arena_malloc(arena, sizeof(HLRItems));
+  HHashTable *index = h_hashtable_new(arena, h_eq_ptr, h_hash_ptr);
+
+  // number the nonterminals. NB: unlike LLk, we do consider HCF_CHARSET
+  // nonterminals here. the HCF_CHOICEs keep the numbers given by g->nts
+  // (the start symbol is 0), charsets follow.
+  size_t n = g->nts->used;
+  H_FOREACH(g->nts, HCFChoice *A, void *i)
+    h_hashtable_put(index, A, i);
   H_END_FOREACH
-
-  while(!h_slist_empty(work)) {
-    const HLRItem *item = h_slist_pop(work);
-    HCFChoice *sym = item->rhs[item->mark]; // symbol after mark
-
-    // if there is a non-terminal after the mark, follow it
-    // NB: unlike LLk, we do consider HCF_CHARSET a non-terminal here
-    if(sym != NULL && (sym->type==HCF_CHOICE || sym->type==HCF_CHARSET)) {
-      // add items corresponding to the productions of sym
-      if(sym->type == HCF_CHOICE) {
-        for(HCFSequence **p=sym->seq; *p; p++) {
-          HLRItem *it = h_lritem_new(arena, sym, (*p)->items, 0);
-          if(!h_hashset_present(items, it)) {
-            h_hashset_put(items, it);
-            h_slist_push(work, it);
-          }
-        }
-      } else {  // HCF_CHARSET
-        for(unsigned int i=0; i<256; i++) {
-          if(charset_isset(sym->charset, i)) {
-            // XXX allocate these single-character symbols statically somewhere
-            HCFChoice **rhs = h_new(HCFChoice *, 2);
-            rhs[0] = h_new(HCFChoice, 1);
-            rhs[0]->type = HCF_CHAR;
-            rhs[0]->chr = i;
-            rhs[1] = NULL;
-            HLRItem *it = h_lritem_new(arena, sym, rhs, 0);
-            h_hashset_put(items, it);
-            // single-character item needs no further work
-          }
+  H_FOREACH_KEY(g->nts, HCFChoice *A)
+    for(HCFSequence **p=A->seq; *p; p++)
+      for(HCFChoice **x=(*p)->items; *x; x++)
+        add_nt(index, *x, &n);
+  H_END_FOREACH
+  it->nnts = n;
+  it->nts = h_arena_malloc(arena, n * sizeof(HCFChoice *));
+  H_FOREACH(index, HCFChoice *A, void *i)
+    it->nts[(uintptr_t)i] = (HCFChoice *)A;
+  H_END_FOREACH
+  assert(it->nts[0] == g->start);
+
+  // count the productions and items
+  size_t nprods = 0;
+  size_t nitems = 0;
+  it->prods = h_arena_malloc(arena, (n+1) * sizeof(size_t));
+  for(size_t i=0; i<n; i++) {
+    HCFChoice *A = it->nts[i];
+    it->prods[i] = nprods;
+    if(A->type == HCF_CHOICE) {
+      for(HCFSequence **p=A->seq; *p; p++) {
+        size_t len = 0;
+        while((*p)->items[len]) len++;
+        nprods++;
+        nitems += len + 1;
+      }
+    } else {    // HCF_CHARSET: one production per byte class
+      for(unsigned int c=0; c<256; c++) {
+        if(charset_isset(A->charset, c) && h_byteclass_rep(g->bclass, c)) {
+          nprods++;
+          nitems += 2;
         }
-        // if sym is a non-terminal, we need a reshape on it
-        // this seems as good a place as any to set it
-        sym->reshape = h_act_first;
       }
+      // if sym is a non-terminal, we need a reshape on it
+      // this seems as good a place as any to set it
+      A->reshape = h_act_first;
+    }
+  }
+  it->prods[n] = nprods;
+
+  // generate the items
+  it->nitems = nitems;
+  it->items = h_arena_malloc(arena, nitems * sizeof(HLRItem));
+  it->next = h_arena_malloc(arena, nitems * sizeof(size_t));
+  it->lhs = h_arena_malloc(arena, nitems * sizeof(size_t));
+  it->base = h_arena_malloc(arena, nprods * sizeof(size_t));
+  size_t id = 0, prod = 0;
+  for(size_t i=0; i<n; i++) {
+    HCFChoice *A = it->nts[i];
+    HCFSequence **p = (A->type == HCF_CHOICE)? A->seq : NULL;
+    unsigned int c = 0;
+
+    for(;;) {
+      HCFChoice **rhs;
+      if(A->type == HCF_CHOICE) {
+        if(!*p) break;
+        rhs = (*p++)->items;
+      } else {
+        while(c < 256 && !(charset_isset(A->charset, c)
+                           && h_byteclass_rep(g->bclass, c)))
+          c++;
+        if(c == 256) break;
+        rhs = single_char_rhs[c++];
+      }
+
+      size_t len = 0;
+      while(rhs[len]) len++;
+      it->base[prod++] = id;
+      for(size_t mark=0; mark<=len; mark++, id++) {
+        HLRItem *item = &it->items[id];
+        item->lhs = A;
+        item->rhs = rhs;
+        item->len = len;
+        item->mark = mark;
+        it->lhs[id] = i;
+
+        HCFChoice *x = rhs[mark];
+        if(x == NULL)
+          it->next[id] = NOSYM;
+        else if(x->type == HCF_CHAR)
+          it->next[id] = x->chr;
+        else if(x->type == HCF_END)
+          it->next[id] = SYM_END;
+        else
+          it->next[id] = SYM_NT((uintptr_t)h_hashtable_get(index, x));
+      }
+    }
+  }
+  assert(id == nitems);
+  assert(prod == nprods);
+
+  // compute the closure bitsets: B is in the closure of A if A =>* B ...
+  // by leftmost derivation steps.
+  size_t words = (n + 63) / 64;
+  it->words = words;
+  it->ntclosure = h_arena_malloc(arena, n * words * sizeof(uint64_t));
+  memset(it->ntclosure, 0, n * words * sizeof(uint64_t));
+  size_t *stack = h_arena_malloc(arena, n * sizeof(size_t));
+  for(size_t i=0; i<n; i++) {
+    uint64_t *cl = it->ntclosure + i*words;
+    size_t sp = 0;
+
+    cl[i/64] |= (uint64_t)1 << (i%64);
+    stack[sp++] = i;
+    while(sp > 0) {
+      size_t j = stack[--sp];
+      for(size_t q=it->prods[j]; q<it->prods[j+1]; q++) {
+        size_t sym = it->next[it->base[q]];
+        if(sym == NOSYM || sym < SYM_NT(0))
+          continue;
+        size_t k = sym - SYM_NT(0);
+        if(cl[k/64] & ((uint64_t)1 << (k%64)))
+          continue;
+        cl[k/64] |= (uint64_t)1 << (k%64);
+        stack[sp++] = k;
+      }
+    }
+  }
+
+  return it;
+}
+
+// a strong hash of a kernel (64-bit FNV-1a with a final avalanche)
+static uint64_t hash_kernel(const size_t *ids, size_t n)
+{
+  uint64_t h = 0xcbf29ce484222325ULL;
+  for(size_t i=0; i<n; i++) {
+    h ^= ids[i];
+    h *= 0x100000001b3ULL;
+  }
+  h ^= h >> 33;
+  h *= 0xff51afd7ed558ccdULL;
+  h ^= h >> 33;
+  return h;
+}
+
+// compute the closure of a kernel; returns the number of items
+// the kernel is copied to the front of out.
+static size_t closure(const HLRItems *it, uint64_t *ntset,
+                      const size_t *kernel, size_t nkernel, size_t *out)
+{
+  size_t n = 0;
+
+  memset(ntset, 0, it->words * sizeof(uint64_t));
+  for(size_t i=0; i<nkernel; i++) {
+    size_t sym = it->next[kernel[i]];
+    if(sym != NOSYM && sym >= SYM_NT(0)) {
+      const uint64_t *cl = it->ntclosure + (sym - SYM_NT(0)) * it->words;
+      for(size_t w=0; w<it->words; w++)
+        ntset[w] |= cl[w];
+    }
+    out[n++] = kernel[i];
+  }
+
+  for(size_t w=0; w<it->words; w++) {
+    for(uint64_t bits=ntset[w]; bits; bits &= bits-1) {
+      size_t A = w*64 + __builtin_ctzll(bits);
+      for(size_t q=it->prods[A]; q<it->prods[A+1]; q++)
+        out[n++] = it->base[q];
+    }
+  }
+
+  return n;
+}
+
+// pairs of (symbol after the mark, advanced item) for grouping by symbol
+typedef struct HLRShift_ {
+  size_t sym;
+  size_t item;
+} HLRShift;
+
+static int cmp_shift(const void *p, const void *q)
+{
+  const HLRShift *a = p, *b = q;
+  if(a->sym != b->sym)
+    return (a->sym < b->sym)? -1 : 1;
+  if(a->item != b->item)
+    return (a->item < b->item)? -1 : 1;
+  return 0;
+}
+
+// growable array of states, and an open-addressed hash table over it.
+// several states may share a kernel (see h_lr1_dfa); only the first of them
+// is entered into the hash table, the others are chained to it via 'twin'.
+typedef struct HLRStateTable_ {
+  HArena *arena;
+  size_t n, cap;
+  size_t **kernel;      // per state: kernel item ids
+  size_t *nkernel;      // per state: kernel size
+  size_t *twin;         // per state: next state with the same kernel (or NOSYM)
+  bool *hashed;         // per state: is it entered into the hash table?
+  HLRState **states;
+  size_t hcap;          // capacity of the hash table, a power of 2
+  size_t *slots;        // state indices, or NOSYM if empty
+  uint64_t *hashes;     // hashes of the kernels of the states
+} HLRStateTable;
+
+static void statetable_init(HLRStateTable *st, HArena *arena)
+{
+  st->arena = arena;
+  st->n = 0;
+  st->cap = 64;
+  st->kernel = h_arena_malloc(arena, st->cap * sizeof(size_t *));
+  st->nkernel = h_arena_malloc(arena, st->cap * sizeof(size_t));
+  st->twin = h_arena_malloc(arena, st->cap * sizeof(size_t));
+  st->hashed = h_arena_malloc(arena, st->cap * sizeof(bool));
+  st->hashes = h_arena_malloc(arena, st->cap * sizeof(uint64_t));
+  st->hcap = 0;
+}
+
+static void statetable_rehash(HLRStateTable *st, size_t hcap)
+{
+  st->hcap = hcap;
+  st->slots = h_arena_malloc(st->arena, hcap * sizeof(size_t));
+  for(size_t i=0; i<hcap; i++)
+    st->slots[i] = NOSYM;
+  for(size_t s=0; s<st->n; s++) {
+    if(!st->hashed[s])
+      continue;
+    size_t i = st->hashes[s] & (hcap-1);
+    while(st->slots[i] != NOSYM)
+      i = (i+1) & (hcap-1);
+    st->slots[i] = s;
+  }
+}
+
+// append a state to the array, without entering it into the hash table
+static size_t statetable_add(HLRStateTable *st, size_t *kernel,
+                             size_t nkernel, uint64_t h)
+{
+  if(st->n == st->cap) {
+    size_t cap = st->cap * 2;
+    size_t **k = h_arena_malloc(st->arena, cap * sizeof(size_t *));
+    size_t *nk = h_arena_malloc(st->arena, cap * sizeof(size_t));
+    size_t *tw = h_arena_malloc(st->arena, cap * sizeof(size_t));
+    bool *hd = h_arena_malloc(st->arena, cap * sizeof(bool));
+    uint64_t *hs = h_arena_malloc(st->arena, cap * sizeof(uint64_t));
+    memcpy(k, st->kernel, st->n * sizeof(size_t *));
+    memcpy(nk, st->nkernel, st->n * sizeof(size_t));
+    memcpy(tw, st->twin, st->n * sizeof(size_t));
+    memcpy(hd, st->hashed, st->n * sizeof(bool));
+    memcpy(hs, st->hashes, st->n * sizeof(uint64_t));
+    st->kernel = k;
+    st->nkernel = nk;
+    st->twin = tw;
+    st->hashed = hd;
+    st->hashes = hs;
+    st->cap = cap;
+  }
+  size_t s = st->n++;
+  st->kernel[s] = kernel;
+  st->nkernel[s] = nkernel;
+  st->twin[s] = NOSYM;
+  st->hashed[s] = false;
+  st->hashes[s] = h;
+  return s;
+}
+
+// find the (first) state with the given kernel or add a new one.
+// sets *isnew accordingly.
+static size_t statetable_get(HLRStateTable *st, const size_t *kernel,
+                             size_t nkernel, bool *isnew)
+{
+  uint64_t h = hash_kernel(kernel, nkernel);
+  size_t i = h & (st->hcap-1);
+
+  for(; st->slots[i] != NOSYM; i = (i+1) & (st->hcap-1)) {
+    size_t s = st->slots[i];
+    if(st->hashes[s] == h && st->nkernel[s] == nkernel
+       && memcmp(st->kernel[s], kernel, nkernel * sizeof(size_t)) == 0) {
+      *isnew = false;
+      return s;
     }
   }
+
+  // add a new state
+  size_t *k = h_arena_malloc(st->arena, nkernel * sizeof(size_t));
+  if(nkernel > 0)
+    memcpy(k, kernel, nkernel * sizeof(size_t));
+  size_t s = statetable_add(st, k, nkernel, h);
+  st->hashed[s] = true;
+  st->slots[i] = s;
+  if(2 * st->n > st->hcap)
+    statetable_rehash(st, 2 * st->hcap);
+
+  *isnew = true;
+  return s;
+}
+
+// add another state with the same kernel as state s
+static size_t statetable_twin(HLRStateTable *st, size_t s)
+{
+  size_t t = statetable_add(st, st->kernel[s], st->nkernel[s], st->hashes[s]);
+  st->twin[t] = st->twin[s];
+  st->twin[s] = t;
+  return t;
 }
 
 HLRDFA *h_lr0_dfa(HCFGrammar *g)
 {
   HArena *arena = g->arena;
-
-  HHashSet *states = h_hashset_new(arena, h_eq_lr_itemset, h_hash_lr_itemset);
-      // maps itemsets to assigned array indices
+  HLRItems *it = enumerate_items(g);
   HSlist *transitions = h_slist_new(arena);
 
-  // list of states that need to be processed
-  // to save lookups, we push two elements per state, the itemset and its
-  // assigned index.
+  HLRStateTable st;
+  statetable_init(&st, arena);
+  statetable_rehash(&st, 128);
+
+  // scratch space
+  uint64_t *ntset = h_arena_malloc(arena, it->words * sizeof(uint64_t));
+  size_t *items = h_arena_malloc(arena, it->nitems * sizeof(size_t));
+  HLRShift *shifts = h_arena_malloc(arena, it->nitems * sizeof(HLRShift));
+  size_t *kernel = h_arena_malloc(arena, it->nitems * sizeof(size_t));
+
+  // list of states that need to be processed, and their closures
   HSlist *work = h_slist_new(arena);
+  HSlist *done = h_slist_new(arena);
+
+  // make initial state. its kernel, the items of the start symbol with the
+  // mark at the beginning, is represented as the empty set. (other kernels
+  // are never empty.) its closure is that of the start symbol.
+  bool isnew;
+  statetable_get(&st, NULL, 0, &isnew);
+  h_slist_push(work, (void *)(uintptr_t)0);
 
-  // make initial state (kernel)
-  HLRState *start = h_lrstate_new(arena);
-  assert(g->start->type == HCF_CHOICE);
-  for(HCFSequence **p=g->start->seq; *p; p++)
-    h_hashset_put(start, h_lritem_new(arena, g->start, (*p)->items, 0));
-  expand_to_closure(g, start);
-  h_hashtable_put(states, start, 0);
-  h_slist_push(work, start);
-  h_slist_push(work, 0);
-  
   // while work to do (on some state)
+  //   compute closure
   //   determine edge symbols
   //   for each edge symbol:
   //     advance respective items -> destination state (kernel)
-  //     compute closure
   //     if destination is a new state:
   //       add it to state set
-  //       add transition to it
   //       add it to the work list
+  //     add transition to it
 
+  HLRState **states = NULL;
+  size_t nstates = 0;
   while(!h_slist_empty(work)) {
-    size_t state_idx = (uintptr_t)h_slist_pop(work);
-    HLRState *state = h_slist_pop(work);
-
-    // maps edge symbols to neighbor states (item sets) of s
-    HHashTable *neighbors = h_hashtable_new(arena, h_eq_symbol, h_hash_symbol);
-
-    // iterate over state (closure) and generate neighboring sets
-    H_FOREACH_KEY(state, HLRItem *item)
-      HCFChoice *sym = item->rhs[item->mark]; // symbol after mark
-
-      if(sym != NULL) { // mark was not at the end
-        // find or create prospective neighbor set
-        HLRState *neighbor = h_hashtable_get(neighbors, sym);
-        if(neighbor == NULL) {
-          neighbor = h_lrstate_new(arena);
-          h_hashtable_put(neighbors, sym, neighbor);
-        }
+    size_t s = (uintptr_t)h_slist_pop(work);
+
+    size_t nitems;
+    if(s == 0) {
+      memset(ntset, 0, it->words * sizeof(uint64_t));
+      nitems = 0;
+      for(size_t q=it->prods[0]; q<it->prods[1]; q++)
+        kernel[nitems++] = it->base[q];     // start symbol is nonterminal 0
+      nitems = closure(it, ntset, kernel, nitems, items);
+    } else {
+      nitems = closure(it, ntset, st.kernel[s], st.nkernel[s], items);
+    }
 
-        // ...and add the advanced item to it
-        h_hashset_put(neighbor, advance_mark(arena, item));
-      }
-    H_END_FOREACH
+    // remember the state's items
+    HLRState *state = h_arena_malloc(arena, sizeof(HLRState));
+    state->nkernel = st.nkernel[s];
+    state->nitems = nitems;
+    state->lookahead = NULL;
+    state->items = h_arena_malloc(arena, nitems * sizeof(HLRItem *));
+    for(size_t i=0; i<nitems; i++)
+      state->items[i] = &it->items[items[i]];
+    h_slist_push(done, state);
+    h_slist_push(done, (void *)(uintptr_t)s);
+
+    // group the advanced items by the symbol after the mark
+    size_t nshifts = 0;
+    for(size_t i=0; i<nitems; i++) {
+      size_t sym = it->next[items[i]];
+      if(sym != NOSYM)
+        shifts[nshifts++] = (HLRShift){sym, items[i] + 1};
+    }
+    qsort(shifts, nshifts, sizeof(HLRShift), cmp_shift);
 
-    // merge expanded neighbor sets into the set of existing states
-    H_FOREACH(neighbors, HCFChoice *symbol, HLRState *neighbor)
-      expand_to_closure(g, neighbor);
+    for(size_t i=0; i<nshifts; ) {
+      size_t nk = 0;
+      size_t j;
+      for(j=i; j<nshifts && shifts[j].sym == shifts[i].sym; j++)
+        kernel[nk++] = shifts[j].item;
 
       // look up existing state, allocate new if not found
-      size_t neighbor_idx;
-      if(!h_hashset_present(states, neighbor)) {
-        neighbor_idx = states->used;
-        h_hashtable_put(states, neighbor, (void *)(uintptr_t)neighbor_idx);
-        h_slist_push(work, neighbor);
-        h_slist_push(work, (void *)(uintptr_t)neighbor_idx);
-      } else {
-        neighbor_idx = (uintptr_t)h_hashtable_get(states, neighbor);
-      }
+      size_t to = statetable_get(&st, kernel, nk, &isnew);
+      if(isnew)
+        h_slist_push(work, (void *)(uintptr_t)to);
 
-      // add transition "state --symbol--> neighbor"
+      // add transition "s --symbol--> to"
+      const HLRItem *item = &it->items[shifts[i].item - 1];
       HLRTransition *t = h_arena_malloc(arena, sizeof(HLRTransition));
-      t->from = state_idx;
-      t->to = neighbor_idx;
-      t->symbol = symbol;
+      t->from = s;
+      t->symbol = item->rhs[item->mark];
+      t->to = to;
       h_slist_push(transitions, t);
-    H_END_FOREACH
+
+      i = j;
+    }
   } // end while(work)
 
   // fill DFA struct
+  nstates = st.n;
+  states = h_arena_malloc(arena, nstates * sizeof(HLRState *));
+  while(!h_slist_empty(done)) {
+    size_t s = (uintptr_t)h_slist_pop(done);
+    states[s] = h_slist_pop(done);
+  }
+
   HLRDFA *dfa = h_arena_malloc(arena, sizeof(HLRDFA));
-  dfa->nstates = states->used;
-  dfa->states = h_arena_malloc(arena, dfa->nstates*sizeof(HLRState *));
-  H_FOREACH(states, HLRState *state, void *v)
-    size_t idx = (uintptr_t)v;
-    dfa->states[idx] = state;
-  H_END_FOREACH
+  dfa->nstates = nstates;
+  dfa->states = (const HLRState **)states;
   dfa->transitions = transitions;
 
   return dfa;
@@ -159,6 +483,375 @@ HLRDFA *h_lr0_dfa(HCFGrammar *g)
 
 
 
+/* Constructing the LR(1) automaton
+ *
+ * The states of the canonical LR(1) automaton carry a set of lookahead
+ * terminals with each kernel item. Many of them share an LR(0) core and are
+ * merged by LALR, sometimes at the price of spurious reduce/reduce conflicts.
+ * Here, states of the same core are merged only if their lookaheads L and L'
+ * are "weakly compatible", i.e. for all pairs of kernel items i < j:
+ *
+ *   (L_i n L'_j) u (L'_i n L_j) = {}  or  L_i n L_j != {}  or  L'_i n L'_j != {}
+ *
+ * [Pager: A Practical General Method for Constructing LR(k) Parsers. 1977]
+ *
+ * Such a merger introduces no conflict that the LR(1) automaton does not
+ * have. So the states of LALR are only split where merging them would
+ * introduce a conflict. A state whose lookaheads grow by a merger is processed
+ * again to propagate them to its successors.
+ */
+
+// per-state bookkeeping of the LR(1) construction
+typedef struct HLR1State_ {
+  HLRTermSet *la;       // lookaheads of the kernel items
+  size_t nsucc;         // number of successors (once processed)
+  size_t *succ;         // successor states, in order of their symbols
+  const HCFChoice **sym;    // the respective symbols
+  bool queued;          // on the work list?
+} HLR1State;
+
+typedef struct HLR1_ {
+  HArena *arena;
+  HLRItems *it;
+  HLRTermSet *first;    // per nonterminal: FIRST set
+  HLRTermSet *sfirst;   // per item: FIRST set of the rhs after the mark
+  uint64_t *snull;      // bitset over items: is the rhs after the mark nullable?
+  HLRTermSet *ntla;     // scratch: per nonterminal: lookahead in closure
+  uint64_t *ntset;      // scratch: nonterminal set for closure
+} HLR1;
+
+static inline bool tset_merge(HLRTermSet *s, const HLRTermSet *t)
+{
+  bool changed = false;
+  for(size_t i=0; i<TSET_WORDS; i++) {
+    changed |= (t->w[i] & ~s->w[i]) != 0;
+    s->w[i] |= t->w[i];
+  }
+  return changed;
+}
+
+static inline bool tset_disjoint(const HLRTermSet *s, const HLRTermSet *t)
+{
+  for(size_t i=0; i<TSET_WORDS; i++)
+    if(s->w[i] & t->w[i])
+      return false;
+  return true;
+}
+
+static inline bool bit_isset(const uint64_t *set, size_t i)
+{
+  return (set[i/64] >> (i%64)) & 1;
+}
+
+static inline void bit_set(uint64_t *set, size_t i)
+{
+  set[i/64] |= (uint64_t)1 << (i%64);
+}
+
+// compute the FIRST sets of nonterminals and item suffixes
+static void lr1_first(HLR1 *c)
+{
+  const HLRItems *it = c->it;
+  size_t n = it->nnts;
+  size_t words = (n + 63) / 64;
+  uint64_t *nullable = h_arena_malloc(c->arena, words * sizeof(uint64_t));
+  bool changed;
+
+  c->first = h_arena_malloc(c->arena, n * sizeof(HLRTermSet));
+  memset(c->first, 0, n * sizeof(HLRTermSet));
+  memset(nullable, 0, words * sizeof(uint64_t));
+  do {
+    changed = false;
+    for(size_t A=0; A<n; A++) {
+      for(size_t q=it->prods[A]; q<it->prods[A+1]; q++) {
+        size_t id;
+        for(id=it->base[q]; it->next[id] != NOSYM; id++) {
+          size_t sym = it->next[id];
+          if(sym < SYM_NT(0)) {     // NB: SYM_END == TSET_END
+            if(!tset_member(&c->first[A], sym)) {
+              tset_add(&c->first[A], sym);
+              changed = true;
+            }
+            break;
+          }
+          size_t B = sym - SYM_NT(0);
+          changed |= tset_merge(&c->first[A], &c->first[B]);
+          if(!bit_isset(nullable, B))
+            break;
+        }
+        if(it->next[id] == NOSYM && !bit_isset(nullable, A)) {
+          bit_set(nullable, A);
+          changed = true;
+        }
+      }
+    }
+  } while(changed);
+
+  c->sfirst = h_arena_malloc(c->arena, it->nitems * sizeof(HLRTermSet));
+  words = (it->nitems + 63) / 64;
+  c->snull = h_arena_malloc(c->arena, words * sizeof(uint64_t));
+  memset(c->snull, 0, words * sizeof(uint64_t));
+  for(size_t q=0; q<it->prods[n]; q++) {
+    size_t id = it->base[q];
+    while(it->next[id] != NOSYM) id++;
+    memset(&c->sfirst[id], 0, sizeof(HLRTermSet));
+    bit_set(c->snull, id);
+    while(id-- > it->base[q]) {
+      size_t sym = it->next[id];
+      memset(&c->sfirst[id], 0, sizeof(HLRTermSet));
+      if(sym < SYM_NT(0)) {
+        tset_add(&c->sfirst[id], sym);
+      } else {
+        size_t B = sym - SYM_NT(0);
+        c->sfirst[id] = c->first[B];
+        if(bit_isset(nullable, B)) {
+          tset_union(&c->sfirst[id], &c->sfirst[id+1]);
+          if(bit_isset(c->snull, id+1))
+            bit_set(c->snull, id);
+        }
+      }
+    }
+  }
+}
+
+// compute the closure of a kernel with lookaheads kla; returns the number of
+// items. like closure(), but also puts the lookahead of each item into ola.
+static size_t closure1(HLR1 *c, const size_t *kernel, const HLRTermSet *kla,
+                       size_t nkernel, size_t *out, HLRTermSet *ola)
+{
+  const HLRItems *it = c->it;
+  size_t n = closure(it, c->ntset, kernel, nkernel, out);
+
+  for(size_t w=0; w<it->words; w++)
+    for(uint64_t bits=c->ntset[w]; bits; bits &= bits-1)
+      memset(&c->ntla[w*64 + __builtin_ctzll(bits)], 0, sizeof(HLRTermSet));
+
+  // the lookahead of "B -> .w" is the same for all productions of B
+  bool changed;
+  do {
+    changed = false;
+    for(size_t i=0; i<n; i++) {
+      size_t id = out[i];
+      size_t sym = it->next[id];
+      if(sym == NOSYM || sym < SYM_NT(0))
+        continue;
+      HLRTermSet *la = &c->ntla[sym - SYM_NT(0)];
+      changed |= tset_merge(la, &c->sfirst[id+1]);
+      if(bit_isset(c->snull, id+1))
+        changed |= tset_merge(la, (i < nkernel)? &kla[i]
+                                                : &c->ntla[it->lhs[id]]);
+    }
+  } while(changed);
+
+  for(size_t i=0; i<n; i++)
+    ola[i] = (i < nkernel)? kla[i] : c->ntla[it->lhs[out[i]]];
+
+  return n;
+}
+
+static bool weakly_compatible(const HLRTermSet *a, const HLRTermSet *b,
+                              size_t n)
+{
+  for(size_t i=0; i<n; i++) {
+    for(size_t j=i+1; j<n; j++) {
+      if(tset_disjoint(&a[i], &b[j]) && tset_disjoint(&b[i], &a[j]))
+        continue;
+      if(tset_disjoint(&a[i], &a[j]) && tset_disjoint(&b[i], &b[j]))
+        return false;
+    }
+  }
+  return true;
+}
+
+static HLR1State *lr1_state(HArena *arena, const HLRTermSet *la, size_t n)
+{
+  HLR1State *info = h_arena_malloc(arena, sizeof(HLR1State));
+  info->la = NULL;
+  if(n > 0) {
+    info->la = h_arena_malloc(arena, n * sizeof(HLRTermSet));
+    memcpy(info->la, la, n * sizeof(HLRTermSet));
+  }
+  info->nsucc = 0;
+  info->succ = NULL;
+  info->sym = NULL;
+  info->queued = true;
+  return info;
+}
+
+// merge lookaheads into those of state t; (re)queue t if they grew
+static void lr1_merge(HLR1State *t, size_t to, const HLRTermSet *la, size_t n,
+                      HSlist *work)
+{
+  bool changed = false;
+  for(size_t i=0; i<n; i++)
+    changed |= tset_merge(&t->la[i], &la[i]);
+  if(changed && !t->queued) {
+    t->queued = true;
+    h_slist_push(work, (void *)(uintptr_t)to);
+  }
+}
+
+HLRDFA *h_lr1_dfa(HCFGrammar *g)
+{
+  HArena *arena = g->arena;
+  HLRItems *it = enumerate_items(g);
+
+  HLR1 c;
+  c.arena = arena;
+  c.it = it;
+  c.ntla = h_arena_malloc(arena, it->nnts * sizeof(HLRTermSet));
+  c.ntset = h_arena_malloc(arena, it->words * sizeof(uint64_t));
+  lr1_first(&c);
+
+  HLRStateTable st;
+  statetable_init(&st, arena);
+  statetable_rehash(&st, 128);
+
+  size_t infocap = 64;
+  HLR1State **info = h_arena_malloc(arena, infocap * sizeof(HLR1State *));
+
+  // scratch space
+  size_t *items = h_arena_malloc(arena, it->nitems * sizeof(size_t));
+  HLRTermSet *la = h_arena_malloc(arena, it->nitems * sizeof(HLRTermSet));
+  size_t *pos = h_arena_malloc(arena, it->nitems * sizeof(size_t));
+  HLRShift *shifts = h_arena_malloc(arena, it->nitems * sizeof(HLRShift));
+  size_t *kernel = h_arena_malloc(arena, it->nitems * sizeof(size_t));
+  HLRTermSet *kla = h_arena_malloc(arena, it->nitems * sizeof(HLRTermSet));
+
+  // the kernel of the initial state is again represented as the empty set.
+  // the items of the start symbol are followed by the end of input.
+  size_t nstart = it->prods[1] - it->prods[0];
+  size_t *start = h_arena_malloc(arena, nstart * sizeof(size_t));
+  HLRTermSet *startla = h_arena_malloc(arena, nstart * sizeof(HLRTermSet));
+  for(size_t i=0; i<nstart; i++) {
+    start[i] = it->base[it->prods[0] + i];
+    memset(&startla[i], 0, sizeof(HLRTermSet));
+    tset_add(&startla[i], TSET_END);
+  }
+
+  HSlist *work = h_slist_new(arena);
+  bool isnew;
+  statetable_get(&st, NULL, 0, &isnew);
+  info[0] = lr1_state(arena, NULL, 0);
+  h_slist_push(work, (void *)(uintptr_t)0);
+
+  while(!h_slist_empty(work)) {
+    size_t s = (uintptr_t)h_slist_pop(work);
+    HLR1State *si = info[s];
+    si->queued = false;
+
+    size_t nitems;
+    if(s == 0)
+      nitems = closure1(&c, start, startla, nstart, items, la);
+    else
+      nitems = closure1(&c, st.kernel[s], si->la, st.nkernel[s], items, la);
+
+    // group the advanced items by the symbol after the mark
+    size_t nshifts = 0;
+    for(size_t i=0; i<nitems; i++) {
+      size_t sym = it->next[items[i]];
+      pos[items[i]] = i;
+      if(sym != NOSYM)
+        shifts[nshifts++] = (HLRShift){sym, items[i] + 1};
+    }
+    qsort(shifts, nshifts, sizeof(HLRShift), cmp_shift);
+
+    // on the first visit, count the successors
+    bool first = (si->succ == NULL);
+    if(first) {
+      for(size_t i=0; i<nshifts; i++)
+        if(i == 0 || shifts[i].sym != shifts[i-1].sym)
+          si->nsucc++;
+      si->succ = h_arena_malloc(arena, si->nsucc * sizeof(size_t));
+      si->sym = h_arena_malloc(arena, si->nsucc * sizeof(HCFChoice *));
+    }
+
+    for(size_t i=0, k=0; i<nshifts; k++) {
+      size_t nk = 0;
+      size_t j;
+      for(j=i; j<nshifts && shifts[j].sym == shifts[i].sym; j++) {
+        kernel[nk] = shifts[j].item;
+        kla[nk] = la[pos[shifts[j].item - 1]];
+        nk++;
+      }
+      i = j;
+
+      if(!first) {    // revisit: propagate to the known successor
+        size_t to = si->succ[k];
+        lr1_merge(info[to], to, kla, nk, work);
+        continue;
+      }
+
+      // look for a compatible state of the same core, else add a new one
+      size_t to = statetable_get(&st, kernel, nk, &isnew);
+      if(!isnew) {
+        size_t t;
+        for(t=to; t != NOSYM; t=st.twin[t])
+          if(weakly_compatible(info[t]->la, kla, nk))
+            break;
+        if(t != NOSYM) {
+          to = t;
+          lr1_merge(info[to], to, kla, nk, work);
+        } else {
+          to = statetable_twin(&st, to);
+          isnew = true;
+        }
+      }
+      if(isnew) {
+        if(to == infocap) {
+          HLR1State **tmp = h_arena_malloc(arena, 2 * infocap * sizeof(HLR1State *));
+          memcpy(tmp, info, infocap * sizeof(HLR1State *));
+          info = tmp;
+          infocap *= 2;
+        }
+        info[to] = lr1_state(arena, kla, nk);
+        h_slist_push(work, (void *)(uintptr_t)to);
+      }
+
+      const HLRItem *item = &it->items[kernel[0] - 1];
+      si->succ[k] = to;
+      si->sym[k] = item->rhs[item->mark];
+    }
+  } // end while(work)
+
+  // fill DFA struct, with the final lookaheads
+  HLRDFA *dfa = h_arena_malloc(arena, sizeof(HLRDFA));
+  dfa->nstates = st.n;
+  dfa->states = h_arena_malloc(arena, st.n * sizeof(HLRState *));
+  dfa->transitions = h_slist_new(arena);
+  for(size_t s=0; s<st.n; s++) {
+    size_t nitems;
+    if(s == 0)
+      nitems = closure1(&c, start, startla, nstart, items, la);
+    else
+      nitems = closure1(&c, st.kernel[s], info[s]->la, st.nkernel[s],
+                        items, la);
+
+    HLRState *state = h_arena_malloc(arena, sizeof(HLRState));
+    HLRTermSet *lookahead = h_arena_malloc(arena, nitems * sizeof(HLRTermSet));
+    state->nkernel = st.nkernel[s];
+    state->nitems = nitems;
+    state->items = h_arena_malloc(arena, nitems * sizeof(HLRItem *));
+    for(size_t i=0; i<nitems; i++)
+      state->items[i] = &it->items[items[i]];
+    memcpy(lookahead, la, nitems * sizeof(HLRTermSet));
+    state->lookahead = lookahead;
+    dfa->states[s] = state;
+
+    for(size_t k=0; k<info[s]->nsucc; k++) {
+      HLRTransition *t = h_arena_malloc(arena, sizeof(HLRTransition));
+      t->from = s;
+      t->symbol = info[s]->sym[k];
+      t->to = info[s]->succ[k];
+      h_slist_push(dfa->transitions, t);
+    }
+  }
+
+  return dfa;
+}
+
+
+
 /* LR(0) table generation */
 
 static inline
@@ -187,8 +880,9 @@ HLRTable *h_lr0_table(HCFGrammar *g, const HLRDFA *dfa)
   HLRTable *table = h_lrtable_new(mm__, dfa->nstates);
   HArena *arena = table->arena;
 
-  // remember start symbol
+  // remember start symbol and byte classes
   table->start = g->start;
+  memcpy(table->bclass, g->bclass, sizeof(table->bclass));
 
   // shift to the accepting end state for the start symbol
   put_shift(table, 0, g->start, HLR_SUCCESS);
@@ -206,7 +900,9 @@ HLRTable *h_lr0_table(HCFGrammar *g, const HLRDFA *dfa)
     bool inadeq = false;
 
     // find reducible items in state
-    H_FOREACH_KEY(dfa->states[i], HLRItem *item)
+    const HLRState *state = dfa->states[i];
+    for(size_t j=0; j<state->nitems; j++) {
+      const HLRItem *item = state->items[j];
       if(item->mark == item->len) { // mark at the end
         HLRAction *reduce = h_reduce_action(arena, item);
         
@@ -223,7 +919,7 @@ HLRTable *h_lr0_table(HCFGrammar *g, const HLRDFA *dfa)
         if(!h_lrtable_row_empty(table, i))
           inadeq = true;
       }
-    H_END_FOREACH
+    }
 
     if(inadeq)
       h_slist_push(table->inadeq, (void *)(uintptr_t)i);
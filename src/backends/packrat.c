@@ -195,14 +195,88 @@ HParseResult* h_do_parse(const HParser* parser, HParseState *state) {
   }
 }
 
+/* Deferred actions: instead of calling an h_action function right away, the
+ * call is recorded in a TT_DEFERRED token and made after the parse, on the
+ * final parse tree only. Alternatives that are tried and then thrown away
+ * never run their actions. Parsers that inspect their operand's value call
+ * h_force_actions first.
+ */
+
+typedef struct HDeferredAction_ {
+  HParseResult *res;    // the action's operand
+  HAction action;
+  void *user_data;
+  bool done;
+  HParsedToken *value;
+} HDeferredAction;
+
+HParsedToken* h_defer_action(HParseState *state, HParseResult *res, HAction action, void *user_data) {
+  HDeferredAction *d = a_new(HDeferredAction, 1);
+  d->res = res;
+  d->action = action;
+  d->user_data = user_data;
+  d->done = false;
+  d->value = NULL;
+
+  HParsedToken *tok = a_new(HParsedToken, 1);
+  tok->token_type = TT_DEFERRED;
+  tok->user = d;
+  if (res->ast) {
+    tok->index = res->ast->index;
+    tok->bit_offset = res->ast->bit_offset;
+  } else {
+    tok->index = 0;
+    tok->bit_offset = 0;
+  }
+  return tok;
+}
+
+static const HParsedToken* force_token(const HParsedToken *tok) {
+  if (!tok)
+    return NULL;
+  if (tok->token_type == TT_DEFERRED) {
+    HDeferredAction *d = tok->user;
+    if (!d->done) {
+      d->res->ast = force_token(d->res->ast);
+      d->value = d->action(d->res, d->user_data);
+      d->done = true;
+    }
+    return d->value;
+  }
+  if (tok->token_type == TT_SEQUENCE) {
+    // like the sequence parsers, drop actions that produce no token
+    HCountedArray *seq = tok->seq;
+    size_t j = 0;
+    for (size_t i=0; i<seq->used; i++) {
+      const HParsedToken *elem = seq->elements[i];
+      bool deferred = elem && elem->token_type == TT_DEFERRED;
+      elem = force_token(elem);
+      if (elem || !deferred)
+	seq->elements[j++] = (HParsedToken*)elem;
+    }
+    seq->used = j;
+  }
+  return tok;
+}
+
+HParseResult* h_force_actions(HParseState *state, HParseResult *res) {
+  if (res && state->defer_actions)
+    res->ast = force_token(res->ast);
+  return res;
+}
+
 int h_packrat_compile(HAllocator* mm__, HParser* parser, const void* params) {
+  const HPackratParams *pp = params;
   parser->backend = PB_PACKRAT;
+  // the only setting is a flag, keep it in the backend_data pointer itself
+  parser->backend_data = (void*)(uintptr_t)(pp && pp->defer_actions);
   return 0; // No compilation necessary, and everything should work
 	    // out of the box.
 }
 
 void h_packrat_free(HParser *parser) {
   parser->backend = PB_PACKRAT; // revert to default, oh that's us
+  parser->backend_data = NULL;
 }
 
 static uint32_t cache_key_hash(const void* key) {
@@ -212,8 +286,9 @@ static bool cache_key_equal(const void* key1, const void* key2) {
   return memcmp(key1, key2, sizeof(HParserCacheKey)) == 0;
 }
 
-HParseResult *h_packrat_parse(HAllocator* mm__, const HParser* parser, HInputStream *input_stream) {
-  HArena * arena = h_new_arena(mm__, 0);
+// parse into an existing arena, which is left alone on failure, whatever
+// backend parser was compiled for
+HParseResult *h_packrat_parse_arena(HArena *arena, const HParser* parser, HInputStream *input_stream, bool defer_actions) {
   HParseState *parse_state = a_new_(arena, HParseState, 1);
   parse_state->cache = h_hashtable_new(arena, cache_key_equal, // key_equal_func
 				       cache_key_hash); // hash_func
@@ -222,13 +297,24 @@ HParseResult *h_packrat_parse(HAllocator* mm__, const HParser* parser, HInputStr
   parse_state->recursion_heads = h_hashtable_new(arena, cache_key_equal,
 						 cache_key_hash);
   parse_state->arena = arena;
+  parse_state->defer_actions = defer_actions;
   HParseResult *res = h_do_parse(parser, parse_state);
+  res = h_force_actions(parse_state, res);
   h_slist_free(parse_state->lr_stack);
   h_hashtable_free(parse_state->recursion_heads);
   // tear down the parse state
   h_hashtable_free(parse_state->cache);
+  return res;
+}
+
+HParseResult *h_packrat_parse(HAllocator* mm__, const HParser* parser, HInputStream *input_stream, HArena *arena) {
+  bool defer_actions = (parser->backend_data != NULL);
+  if (arena)
+    return h_packrat_parse_arena(arena, parser, input_stream, defer_actions);
+  arena = h_new_arena(mm__, 0);
+  HParseResult *res = h_packrat_parse_arena(arena, parser, input_stream, defer_actions);
   if (!res)
-    h_delete_arena(parse_state->arena);
+    h_delete_arena(arena);
 
   return res;
 }
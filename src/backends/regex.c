@@ -31,7 +31,7 @@ typedef struct HRVMThread_ {
   uint16_t ip;
 } HRVMThread;
 
-HParseResult *run_trace(HAllocator *mm__, HRVMProg *orig_prog, HRVMTrace *trace, const uint8_t *input, int len);
+HParseResult *run_trace(HAllocator *mm__, HRVMProg *orig_prog, HRVMTrace *trace, const uint8_t *input, int len, HArena *parent);
 
 HRVMTrace *invert_trace(HRVMTrace *trace) {
   HRVMTrace *last = NULL;
@@ -48,8 +48,8 @@ HRVMTrace *invert_trace(HRVMTrace *trace) {
   return last;
 }
 
-void* h_rvm_run__m(HAllocator *mm__, HRVMProg *prog, const uint8_t* input, size_t len) {
-  HArena *arena = h_new_arena(mm__, 0);
+void* h_rvm_run__m(HAllocator *mm__, HRVMProg *prog, const uint8_t* input, size_t len, HArena *parent) {
+  HArena *arena = h_parse_scratch(mm__, parent);
   HSArray *heads_n = h_sarray_new(mm__, prog->length), // Both of these contain HRVMTrace*'s
     *heads_p = h_sarray_new(mm__, prog->length);
 
@@ -161,16 +161,16 @@ void* h_rvm_run__m(HAllocator *mm__, HRVMProg *prog, const uint8_t* input, size_
  match_fail:
   if (ret_trace == NULL) {
     // No match found; definite failure.
-    h_delete_arena(arena);
+    h_parse_scratch_done(parent, arena);
     return NULL;
   }
   
   // Invert the direction of the trace linked list.
 
   ret_trace = invert_trace(ret_trace);
-  HParseResult *ret = run_trace(mm__, prog, ret_trace, input, len);
-  // ret is in its own arena
-  h_delete_arena(arena);
+  HParseResult *ret = run_trace(mm__, prog, ret_trace, input, len, parent);
+  // ret is in its own arena, or parent
+  h_parse_scratch_done(parent, arena);
   return ret;
 }
 #undef PUSH_SVM
@@ -186,10 +186,10 @@ void svm_stack_ensure_cap(HAllocator *mm__, HSVMContext *ctx, size_t addl) {
   }
 }
 
-HParseResult *run_trace(HAllocator *mm__, HRVMProg *orig_prog, HRVMTrace *trace, const uint8_t *input, int len) {
+HParseResult *run_trace(HAllocator *mm__, HRVMProg *orig_prog, HRVMTrace *trace, const uint8_t *input, int len, HArena *parent) {
   // orig_prog is only used for the action table
   HSVMContext ctx;
-  HArena *arena = h_new_arena(mm__, 0);
+  HArena *arena = parent ? parent : h_new_arena(mm__, 0);
   ctx.stack_count = 0;
   ctx.stack_capacity = 16;
   ctx.stack = h_new(HParsedToken*, ctx.stack_capacity);
@@ -243,7 +243,8 @@ HParseResult *run_trace(HAllocator *mm__, HRVMProg *orig_prog, HRVMTrace *trace,
     }
   }
  fail:
-  h_delete_arena(arena);
+  if (!parent)
+    h_delete_arena(arena);
   return NULL;
 }
 
@@ -361,8 +362,8 @@ static int h_regex_compile(HAllocator *mm__, HParser* parser, const void* params
   return 0;
 }
 
-static HParseResult *h_regex_parse(HAllocator* mm__, const HParser* parser, HInputStream *input_stream) {
-  return h_rvm_run__m(mm__, (HRVMProg*)parser->backend_data, input_stream->input, input_stream->length);
+static HParseResult *h_regex_parse(HAllocator* mm__, const HParser* parser, HInputStream *input_stream, HArena *arena) {
+  return h_rvm_run__m(mm__, (HRVMProg*)parser->backend_data, input_stream->input, input_stream->length, arena);
 }
 
 HParserBackendVTable h__regex_backend_vtable = {
@@ -60,7 +60,12 @@ HBenchmarkResults *h_benchmark__m(HAllocator* mm__, HParser* parser, HParserTest
   for (backend = PB_MIN; backend <= PB_MAX; backend++) {
     ret->results[backend].backend = backend;
     // Step 1: Compile grammar for given parser...
-    if (h_compile(parser, backend, NULL) == -1) {
+    struct timespec ts_start, ts_end;
+    h_benchmark_clock_gettime(&ts_start);
+    int compiled = h_compile(parser, backend, NULL);
+    h_benchmark_clock_gettime(&ts_end);
+    ret->results[backend].compile_time = (ts_end.tv_sec - ts_start.tv_sec) * 1000000000 + (ts_end.tv_nsec - ts_start.tv_nsec);
+    if (compiled == -1) {
       // backend inappropriate for grammar...
       fprintf(stderr, "failed\n");
       ret->results[backend].compile_success = false;
@@ -131,6 +136,7 @@ HBenchmarkResults *h_benchmark__m(HAllocator* mm__, HParser* parser, HParserTest
 void h_benchmark_report(FILE* stream, HBenchmarkResults* result) {
   for (size_t i=0; i<result->len; ++i) {
     fprintf(stream, "Backend %zd ... \n", i);
+    fprintf(stream, "Compile: %zd ns\n", result->results[i].compile_time);
     for (size_t j=0; j<result->results[i].n_testcases; ++j) {
       if(result->results[i].cases == NULL)
         continue;
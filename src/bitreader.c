@@ -15,8 +15,21 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
  */
 
+#include <assert.h>
 #include <stdint.h>
 #include <stdio.h>
+#include <string.h>
+// Vector code beyond the SSE2 baseline is compiled for its own instruction
+// set with a target attribute and only run if the CPU has it, so the same
+// build is fast on new machines and still works on old ones.
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define H_X86_DISPATCH
+#define H_TARGET(isa) __attribute__((target(isa)))
+#define h_cpu_has(isa) __builtin_cpu_supports(isa)
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 #include "internal.h"
 #include "hammer.h"
 #include "test_suite.h"
@@ -26,16 +39,17 @@
 #define LDB(range,i) (((i)>>LSB(range))&((1<<(MSB(range)-LSB(range)+1))-1))
 
 
-int64_t h_read_bits(HInputStream* state, int count, char signed_p) {
-  // BUG: Does not 
-  int64_t out = 0;
+// Reads near the end of the input, and those spanning more than 8 bytes, go
+// bit segment by bit segment.
+static int64_t read_bits_slow(HInputStream* state, int count, char signed_p) {
+  uint64_t out = 0;
   int offset = 0;
   int final_shift = 0;
-  int64_t msb = ((signed_p ? 1LL:0) << (count - 1)); // 0 if unsigned, else 1 << (nbits - 1)
+  uint64_t msb = ((signed_p ? 1ULL:0) << (count - 1)); // 0 if unsigned, else 1 << (nbits - 1)
   
   
   // overflow check...
-  int bits_left = (state->length - state->index); // well, bytes for now
+  int64_t bits_left = (state->length - state->index); // well, bytes for now
   if (bits_left <= 64) { // Large enough to handle any valid count, but small enough that overflow isn't a problem.
     // not in danger of overflowing, so add in bits
     // add in number of bits...
@@ -54,57 +68,459 @@ int64_t h_read_bits(HInputStream* state, int count, char signed_p) {
       final_shift = 0;
   }
   
-  if ((state->bit_offset & 0x7) == 0 && (count & 0x7) == 0) {
-    // fast path
-    if (state->endianness & BYTE_BIG_ENDIAN) {
-      while (count > 0) {
-	count -= 8;
-	out = (out << 8) | state->input[state->index++];
+  while (count) {
+    int segment, segment_len;
+    // Read a segment...
+    if (state->endianness & BIT_BIG_ENDIAN) {
+      if (count >= state->bit_offset) {
+        segment_len = state->bit_offset;
+        state->bit_offset = 8;
+        segment = state->input[state->index] & ((1 << segment_len) - 1);
+        state->index++;
+      } else {
+        segment_len = count;
+        state->bit_offset -= count;
+        segment = (state->input[state->index] >> state->bit_offset) & ((1 << segment_len) - 1);
       }
-    } else {
-      while (count > 0) {
-	count -= 8;
-	out |= state->input[state->index++] << count;
+    } else { // BIT_LITTLE_ENDIAN
+      if (count + state->bit_offset >= 8) {
+        segment_len = 8 - state->bit_offset;
+        segment = (state->input[state->index] >> state->bit_offset);
+        state->index++;
+        state->bit_offset = 0;
+      } else {
+        segment_len = count;
+        segment = (state->input[state->index] >> state->bit_offset) & ((1 << segment_len) - 1);
+        state->bit_offset += segment_len;
       }
     }
+    
+    // have a valid segment; time to assemble the byte
+    if (state->endianness & BYTE_BIG_ENDIAN) {
+      out = out << segment_len | segment;
+    } else { // BYTE_LITTLE_ENDIAN
+      out |= (uint64_t)segment << offset;
+      offset += segment_len;
+    }
+    count -= segment_len;
+  }
+  out = final_shift < 64 ? out << final_shift : 0;
+  return (out ^ msb) - msb; // perform sign extension
+}
+
+#define MASK(n) (((uint64_t)1 << (n)) - 1)    // for n < 64
+
+int64_t h_read_bits(HInputStream* state, int count, char signed_p) {
+  // bits of the current byte already consumed
+  int skip = (state->endianness & BIT_BIG_ENDIAN) ? 8 - state->bit_offset
+                                                 : state->bit_offset;
+
+  if (count <= 0 || skip + count > 64 || state->length - state->index < 8)
+    return read_bits_slow(state, count, signed_p);
+
+  // fast path: all bits lie in the next 8 bytes; load them at once.
+  const uint8_t *p = state->input + state->index;
+  uint64_t out;
+
+  if (!(state->endianness & BIT_BIG_ENDIAN) == !(state->endianness & BYTE_BIG_ENDIAN)) {
+    // bits and bytes in the same order: one contiguous field of the word
+    if (state->endianness & BIT_BIG_ENDIAN)
+      out = (h_load_be64(p) << skip) >> (64 - count);
+    else
+      out = ((h_load_le64(p) >> skip) << (64 - count)) >> (64 - count);
   } else {
-    while (count) {
-      int segment, segment_len;
-      // Read a segment...
-      if (state->endianness & BIT_BIG_ENDIAN) {
-	if (count >= state->bit_offset) {
-	  segment_len = state->bit_offset;
-	  state->bit_offset = 8;
-	  segment = state->input[state->index] & ((1 << segment_len) - 1);
-	  state->index++;
-	} else {
-	  segment_len = count;
-	  state->bit_offset -= count;
-	  segment = (state->input[state->index] >> state->bit_offset) & ((1 << segment_len) - 1);
-	}
-      } else { // BIT_LITTLE_ENDIAN
-	if (count + state->bit_offset >= 8) {
-	  segment_len = 8 - state->bit_offset;
-	  segment = (state->input[state->index] >> state->bit_offset);
-	  state->index++;
-	  state->bit_offset = 0;
-	} else {
-	  segment_len = count;
-	  segment = (state->input[state->index] >> state->bit_offset) & ((1 << segment_len) - 1);
-	  state->bit_offset += segment_len;
-	}
-      }
-      
-      // have a valid segment; time to assemble the byte
-      if (state->endianness & BYTE_BIG_ENDIAN) {
-	out = out << segment_len | segment;
-      } else { // BYTE_LITTLE_ENDIAN
-	out |= segment << offset;
-	offset += segment_len;
+    // the bits are taken in segments that do not cross byte boundaries: the
+    // rest of the current byte (l0 bits), k whole bytes, and r bits more.
+    // each segment is a number in bit order; they are put together in byte
+    // order.
+    uint64_t w = h_load_le64(p);
+    int l0 = count < 8 - skip ? count : 8 - skip;
+    int k = (count - l0) / 8;
+    int r = (count - l0) % 8;
+
+    if (state->endianness & BIT_BIG_ENDIAN) {   // least significant first
+      out = ((w >> (8 - skip - l0)) & MASK(l0))
+            | ((w >> 8) & MASK(8*k)) << l0;
+      if (r)
+        out |= ((w >> (8*k + 16 - r)) & MASK(r)) << (l0 + 8*k);
+    } else {                                    // most significant first
+      out = ((w >> skip) & MASK(l0)) << (8*k + r);
+      if (k)
+        out |= (h_load_be64(p) << 8) >> (64 - 8*k) << r;
+      if (r)
+        out |= (w >> (8*k + 8)) & MASK(r);
+    }
+  }
+
+  int end = skip + count;
+  state->index += end / 8;
+  if (state->endianness & BIT_BIG_ENDIAN)
+    state->bit_offset = 8 - end % 8;
+  else
+    state->bit_offset = end % 8;
+
+  uint64_t msb = (uint64_t)(signed_p ? 1 : 0) << (count - 1);
+  return (int64_t)((out ^ msb) - msb); // perform sign extension
+}
+
+// The next byte of input, or -1 at its end; *after is the stream past it.
+int h_next_byte(const HInputStream *in, HInputStream *after) {
+  *after = *in;
+  size_t avail = in->length - in->index;
+  if (avail == 0 || (!h_input_aligned(in) && avail < 2))
+    return -1;
+  return h_read_bits(after, 8, false);
+}
+
+void h_span_set_init(HSpanSet *set, HCharset cs) {
+  set->cs = cs;
+  set->nranges = 0;
+  for (int c = 0; c < 256; c++) {
+    if (!charset_isset(cs, c))
+      continue;
+    if (c > 0 && charset_isset(cs, c - 1)) {
+      set->hi[set->nranges - 1] = c;
+      continue;
+    }
+    if (set->nranges == H_SPAN_RANGES) {
+      set->nranges = 0;   // too many; use the bitmap only
+      return;
+    }
+    set->lo[set->nranges] = set->hi[set->nranges] = c;
+    set->nranges++;
+  }
+}
+
+static inline bool span_isset(const HSpanSet *set, uint8_t c) {
+  if (set->cs)
+    return charset_isset(set->cs, c);
+  for (int i = 0; i < set->nranges; i++)
+    if ((uint8_t)(c - set->lo[i]) <= (uint8_t)(set->hi[i] - set->lo[i]))
+      return true;
+  return false;
+}
+
+// Vector versions of the range test: c is in [lo, hi] iff
+// min(c - lo, hi - lo) == c - lo, in unsigned bytes. Each returns the number
+// of bytes in the set at the start of [p, end) and stops scanning at the first
+// block containing one that is not.
+#if defined(H_X86_DISPATCH)
+H_TARGET("avx2")
+static size_t span_avx2(const HSpanSet *set, const uint8_t *p, const uint8_t *end) {
+  __m256i lo[H_SPAN_RANGES], width[H_SPAN_RANGES];
+  for (int i = 0; i < set->nranges; i++) {
+    lo[i] = _mm256_set1_epi8(set->lo[i]);
+    width[i] = _mm256_set1_epi8(set->hi[i] - set->lo[i]);
+  }
+  const uint8_t *q = p;
+  for (; end - q >= 32; q += 32) {
+    __m256i x = _mm256_loadu_si256((const __m256i *)q);
+    __m256i in = _mm256_setzero_si256();
+    for (int i = 0; i < set->nranges; i++) {
+      __m256i d = _mm256_sub_epi8(x, lo[i]);
+      in = _mm256_or_si256(in, _mm256_cmpeq_epi8(_mm256_min_epu8(d, width[i]), d));
+    }
+    uint32_t out = ~(uint32_t)_mm256_movemask_epi8(in);
+    if (out)
+      return q - p + __builtin_ctz(out);
+  }
+  return q - p;
+}
+#endif
+
+#if defined(__SSE2__)
+static size_t span_sse2(const HSpanSet *set, const uint8_t *p, const uint8_t *end) {
+  __m128i lo[H_SPAN_RANGES], width[H_SPAN_RANGES];
+  for (int i = 0; i < set->nranges; i++) {
+    lo[i] = _mm_set1_epi8(set->lo[i]);
+    width[i] = _mm_set1_epi8(set->hi[i] - set->lo[i]);
+  }
+  const uint8_t *q = p;
+  for (; end - q >= 16; q += 16) {
+    __m128i x = _mm_loadu_si128((const __m128i *)q);
+    __m128i in = _mm_setzero_si128();
+    for (int i = 0; i < set->nranges; i++) {
+      __m128i d = _mm_sub_epi8(x, lo[i]);
+      in = _mm_or_si128(in, _mm_cmpeq_epi8(_mm_min_epu8(d, width[i]), d));
+    }
+    uint32_t out = ~(uint32_t)_mm_movemask_epi8(in) & 0xFFFF;
+    if (out)
+      return q - p + __builtin_ctz(out);
+  }
+  return q - p;
+}
+#endif
+
+// Consume the longest run of bytes in set. The stream must be byte-aligned.
+// Returns the length of the run; the stream is left at the first byte not in
+// the set (or at the end of input).
+size_t h_read_span(HInputStream* state, const HSpanSet *set) {
+  assert((state->bit_offset & 0x7) == 0);
+  const uint8_t *p = state->input + state->index;
+  const uint8_t *end = state->input + state->length;
+  const uint8_t *q = p;
+
+  if (set->nranges > 0) {
+#if defined(H_X86_DISPATCH)
+    if (h_cpu_has("avx2")) {
+      q += span_avx2(set, q, end);
+      if (end - q >= 32)
+        goto done;    // stopped at a byte not in the set
+    }
+#endif
+#if defined(__SSE2__)
+    q += span_sse2(set, q, end);
+    if (end - q >= 16)
+      goto done;
+#endif
+  }
+  while (q < end && span_isset(set, *q))
+    q++;
+
+ done:
+  state->index += q - p;
+  return q - p;
+}
+
+// Reverse the bytes of each width-byte integer in p[0..n*width). The vector
+// versions do whole blocks and return the number of bytes done.
+#if defined(H_X86_DISPATCH)
+H_TARGET("avx2")
+static size_t bswap_avx2(uint8_t *p, size_t len, int width) {
+  __m128i lane;
+  switch (width) {
+  case 2: lane = _mm_setr_epi8(1,0, 3,2, 5,4, 7,6, 9,8, 11,10, 13,12, 15,14); break;
+  case 4: lane = _mm_setr_epi8(3,2,1,0, 7,6,5,4, 11,10,9,8, 15,14,13,12); break;
+  default: lane = _mm_setr_epi8(7,6,5,4,3,2,1,0, 15,14,13,12,11,10,9,8); break;
+  }
+  __m256i shuf = _mm256_broadcastsi128_si256(lane);
+  size_t i = 0;
+  for (; len - i >= 32; i += 32) {
+    __m256i x = _mm256_loadu_si256((const __m256i *)(p + i));
+    _mm256_storeu_si256((__m256i *)(p + i), _mm256_shuffle_epi8(x, shuf));
+  }
+  return i;
+}
+#endif
+
+#if defined(__SSE2__)
+static size_t bswap_sse2(uint8_t *p, size_t len, int width) {
+  size_t i = 0;
+  for (; len - i >= 16; i += 16) {
+    __m128i x = _mm_loadu_si128((const __m128i *)(p + i));
+    // swap the bytes of each 16-bit word, then the words of wider integers
+    x = _mm_or_si128(_mm_slli_epi16(x, 8), _mm_srli_epi16(x, 8));
+    if (width == 4) {
+      x = _mm_shufflelo_epi16(x, _MM_SHUFFLE(2, 3, 0, 1));
+      x = _mm_shufflehi_epi16(x, _MM_SHUFFLE(2, 3, 0, 1));
+    } else if (width == 8) {
+      x = _mm_shufflelo_epi16(x, _MM_SHUFFLE(0, 1, 2, 3));
+      x = _mm_shufflehi_epi16(x, _MM_SHUFFLE(0, 1, 2, 3));
+    }
+    _mm_storeu_si128((__m128i *)(p + i), x);
+  }
+  return i;
+}
+#endif
+
+static void bswap_array(uint8_t *p, size_t n, int width) {
+  size_t len = n * width, i = 0;
+#if defined(H_X86_DISPATCH)
+  if (h_cpu_has("avx2"))
+    i += bswap_avx2(p + i, len - i, width);
+#endif
+#if defined(__SSE2__)
+  i += bswap_sse2(p + i, len - i, width);
+#endif
+  for (; i < len; i += width) {
+    switch (width) {
+    case 2: { uint16_t x; memcpy(&x, p + i, 2); x = __builtin_bswap16(x); memcpy(p + i, &x, 2); break; }
+    case 4: { uint32_t x; memcpy(&x, p + i, 4); x = __builtin_bswap32(x); memcpy(p + i, &x, 4); break; }
+    case 8: { uint64_t x; memcpy(&x, p + i, 8); x = __builtin_bswap64(x); memcpy(p + i, &x, 8); break; }
+    }
+  }
+}
+
+// Read n unsigned integers of width (1, 2, 4 or 8) bytes, as h_read_bits
+// would read them one by one, into dst in host byte order. The input must
+// hold them all.
+void h_read_packed(HInputStream* state, void *dst, size_t n, int width) {
+  assert(width == 1 || width == 2 || width == 4 || width == 8);
+  if (n == 0)
+    return;
+  if ((state->bit_offset & 0x7) != 0) {
+    uint8_t *out = dst;
+    for (size_t i = 0; i < n; i++, out += width) {
+      uint64_t x = h_read_bits(state, width * 8, false);
+      switch (width) {
+      case 1: *out = x; break;
+      case 2: { uint16_t y = x; memcpy(out, &y, 2); break; }
+      case 4: { uint32_t y = x; memcpy(out, &y, 4); break; }
+      case 8: memcpy(out, &x, 8); break;
       }
-      count -= segment_len;
     }
+    return;
   }
-  out <<= final_shift;
-  return (out ^ msb) - msb; // perform sign extension
+
+  memcpy(dst, state->input + state->index, n * width);
+  state->index += n * width;
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+  bool swap = !(state->endianness & BYTE_BIG_ENDIAN);
+#else
+  bool swap = (state->endianness & BYTE_BIG_ENDIAN);
+#endif
+  if (swap && width > 1)
+    bswap_array(dst, n, width);
+}
+
+// The length of the well-formed UTF-8 character at p (Unicode table 3-7), or
+// 0 if there is none before end.
+static size_t utf8_char_len(const uint8_t *p, const uint8_t *end) {
+  uint8_t c = p[0];
+  if (c < 0x80)
+    return 1;
+  size_t len;
+  uint8_t lo = 0x80, hi = 0xBF;   // the range of the second byte
+  if (c < 0xC2)
+    return 0;
+  else if (c < 0xE0)
+    len = 2;
+  else if (c < 0xF0) {
+    len = 3;
+    if (c == 0xE0) lo = 0xA0;       // overlong
+    else if (c == 0xED) hi = 0x9F;  // surrogates
+  } else if (c < 0xF5) {
+    len = 4;
+    if (c == 0xF0) lo = 0x90;       // overlong
+    else if (c == 0xF4) hi = 0x8F;  // above U+10FFFF
+  } else
+    return 0;
+  if ((size_t)(end - p) < len || p[1] < lo || p[1] > hi)
+    return 0;
+  for (size_t i = 2; i < len; i++)
+    if ((p[i] & 0xC0) != 0x80)
+      return 0;
+  return len;
+}
+
+#if defined(H_X86_DISPATCH)
+// Keiser and Lemire's validation by table lookup ("Validating UTF-8 in less
+// than one instruction per byte", 2021). Each byte of a block is checked
+// against the one before it through three 16-entry tables of error bits, and
+// the continuations of 3- and 4-byte characters are counted separately.
+// Returns the number of bytes, whole blocks of 16, known to be valid except
+// perhaps for a character cut off at the end.
+#define U8_TOO_SHORT  (1<<0)   // lead byte not followed by a continuation
+#define U8_TOO_LONG   (1<<1)   // ASCII followed by a continuation
+#define U8_OVERLONG_3 (1<<2)
+#define U8_TOO_LARGE  (1<<3)
+#define U8_SURROGATE  (1<<4)
+#define U8_OVERLONG_2 (1<<5)
+#define U8_TOO_LARGE_1000 (1<<6)
+#define U8_OVERLONG_4 (1<<6)
+#define U8_TWO_CONTS  (1<<7)   // a continuation after a continuation; fine
+                               // only if the 3-/4-byte count says so
+#define U8_CARRY (U8_TOO_SHORT | U8_TOO_LONG | U8_TWO_CONTS)
+
+H_TARGET("ssse3")
+static size_t utf8_ssse3(const uint8_t *p, const uint8_t *end) {
+  const __m128i byte_1_high = _mm_setr_epi8(
+    U8_TOO_LONG, U8_TOO_LONG, U8_TOO_LONG, U8_TOO_LONG,
+    U8_TOO_LONG, U8_TOO_LONG, U8_TOO_LONG, U8_TOO_LONG,
+    U8_TWO_CONTS, U8_TWO_CONTS, U8_TWO_CONTS, U8_TWO_CONTS,
+    U8_TOO_SHORT | U8_OVERLONG_2,
+    U8_TOO_SHORT,
+    U8_TOO_SHORT | U8_OVERLONG_3 | U8_SURROGATE,
+    U8_TOO_SHORT | U8_TOO_LARGE | U8_TOO_LARGE_1000 | U8_OVERLONG_4);
+  const __m128i byte_1_low = _mm_setr_epi8(
+    U8_CARRY | U8_OVERLONG_3 | U8_OVERLONG_2 | U8_OVERLONG_4,
+    U8_CARRY | U8_OVERLONG_2,
+    U8_CARRY,
+    U8_CARRY,
+    U8_CARRY | U8_TOO_LARGE,
+    U8_CARRY | U8_TOO_LARGE | U8_TOO_LARGE_1000,
+    U8_CARRY | U8_TOO_LARGE | U8_TOO_LARGE_1000,
+    U8_CARRY | U8_TOO_LARGE | U8_TOO_LARGE_1000,
+    U8_CARRY | U8_TOO_LARGE | U8_TOO_LARGE_1000,
+    U8_CARRY | U8_TOO_LARGE | U8_TOO_LARGE_1000,
+    U8_CARRY | U8_TOO_LARGE | U8_TOO_LARGE_1000,
+    U8_CARRY | U8_TOO_LARGE | U8_TOO_LARGE_1000,
+    U8_CARRY | U8_TOO_LARGE | U8_TOO_LARGE_1000,
+    U8_CARRY | U8_TOO_LARGE | U8_TOO_LARGE_1000 | U8_SURROGATE,
+    U8_CARRY | U8_TOO_LARGE | U8_TOO_LARGE_1000,
+    U8_CARRY | U8_TOO_LARGE | U8_TOO_LARGE_1000);
+  const __m128i byte_2_high = _mm_setr_epi8(
+    U8_TOO_SHORT, U8_TOO_SHORT, U8_TOO_SHORT, U8_TOO_SHORT,
+    U8_TOO_SHORT, U8_TOO_SHORT, U8_TOO_SHORT, U8_TOO_SHORT,
+    U8_TOO_LONG | U8_OVERLONG_2 | U8_TWO_CONTS | U8_OVERLONG_3 | U8_TOO_LARGE_1000 | U8_OVERLONG_4,
+    U8_TOO_LONG | U8_OVERLONG_2 | U8_TWO_CONTS | U8_OVERLONG_3 | U8_TOO_LARGE,
+    U8_TOO_LONG | U8_OVERLONG_2 | U8_TWO_CONTS | U8_SURROGATE | U8_TOO_LARGE,
+    U8_TOO_LONG | U8_OVERLONG_2 | U8_TWO_CONTS | U8_SURROGATE | U8_TOO_LARGE,
+    U8_TOO_SHORT, U8_TOO_SHORT, U8_TOO_SHORT, U8_TOO_SHORT);
+  const __m128i nibble = _mm_set1_epi8(0x0F);
+  const __m128i high = _mm_set1_epi8((char)0x80);
+  // which of the last 3 bytes of a block start a character it cuts off
+  const __m128i incomplete = _mm_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+                                           (char)(0xF0-1), (char)(0xE0-1), (char)(0xC0-1));
+
+  __m128i prev = _mm_setzero_si128(), prev_incomplete = _mm_setzero_si128();
+  const uint8_t *q = p;
+  for (; end - q >= 16; q += 16) {
+    __m128i x = _mm_loadu_si128((const __m128i *)q);
+    __m128i error, cut;
+    if (_mm_movemask_epi8(x) == 0) {
+      // ASCII; fine unless the block before cut off a character
+      error = prev_incomplete;
+      cut = _mm_setzero_si128();
+    } else {
+      __m128i prev1 = _mm_alignr_epi8(x, prev, 15);
+      __m128i sc = _mm_and_si128(
+        _mm_and_si128(_mm_shuffle_epi8(byte_1_high, _mm_and_si128(_mm_srli_epi16(prev1, 4), nibble)),
+                      _mm_shuffle_epi8(byte_1_low, _mm_and_si128(prev1, nibble))),
+        _mm_shuffle_epi8(byte_2_high, _mm_and_si128(_mm_srli_epi16(x, 4), nibble)));
+      // bytes 2 and 3 after a 3- or 4-byte lead must be continuations
+      __m128i third = _mm_subs_epu8(_mm_alignr_epi8(x, prev, 14), _mm_set1_epi8((char)(0xE0-0x80)));
+      __m128i fourth = _mm_subs_epu8(_mm_alignr_epi8(x, prev, 13), _mm_set1_epi8((char)(0xF0-0x80)));
+      error = _mm_xor_si128(_mm_and_si128(_mm_or_si128(third, fourth), high), sc);
+      cut = _mm_subs_epu8(x, incomplete);
+    }
+    if (_mm_movemask_epi8(_mm_cmpeq_epi8(error, _mm_setzero_si128())) != 0xFFFF)
+      break;
+    prev = x;
+    prev_incomplete = cut;
+  }
+  return q - p;
+}
+#endif
+
+// Consume the longest run of well-formed UTF-8 characters. The stream must be
+// byte-aligned. Returns the length of the run in bytes.
+size_t h_read_utf8(HInputStream* state) {
+  assert((state->bit_offset & 0x7) == 0);
+  const uint8_t *p = state->input + state->index;
+  const uint8_t *end = state->input + state->length;
+  const uint8_t *q = p;
+
+#if defined(H_X86_DISPATCH)
+  if (h_cpu_has("ssse3")) {
+    q += utf8_ssse3(q, end);
+    // start over at the last character the blocks may have cut off (or got
+    // wrong): back to the lead byte before any continuations
+    for (int i = 0; i < 3 && q > p && (q[-1] & 0xC0) == 0x80; i++)
+      q--;
+    if (q > p && q[-1] >= 0xC0)
+      q--;
+  }
+#endif
+#if defined(__SSE2__)
+  // skip ASCII a block at a time
+  for (; end - q >= 16; q += 16)
+    if (_mm_movemask_epi8(_mm_loadu_si128((const __m128i *)q)) != 0)
+      break;
+#endif
+  for (size_t len; q < end && (len = utf8_char_len(q, end)) > 0; q += len)
+    ;
+
+  state->index += q - p;
+  return q - p;
 }
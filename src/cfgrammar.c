@@ -23,6 +23,8 @@ HCFGrammar *h_cfgrammar_new(HAllocator *mm__)
   g->first  = NULL;
   g->follow = NULL;
   g->kmax   = 0;    // will be increased as needed by ensure_k
+  for(size_t c=0; c<256; c++)
+    g->bclass[c] = c;   // all bytes distinct until collect_bclasses
 
   HStringMap *eps = h_stringmap_new(g->arena);
   h_stringmap_put_epsilon(eps, INSET);
@@ -42,6 +44,7 @@ void h_cfgrammar_free(HCFGrammar *g)
 // helpers
 static void collect_nts(HCFGrammar *grammar, HCFChoice *symbol);
 static void collect_geneps(HCFGrammar *grammar);
+static void collect_bclasses(HCFGrammar *grammar);
 
 
 HCFGrammar *h_cfgrammar(HAllocator* mm__, const HParser *parser)
@@ -73,6 +76,8 @@ HCFGrammar *h_cfgrammar_(HAllocator* mm__, HCFChoice *desugared)
     nt->seq[1] = NULL;
     nt->pred = NULL;
     nt->action = NULL;
+    nt->prec = 0;
+    nt->capture = false;
     nt->reshape = h_act_first;
     h_hashset_put(g->nts, nt);
     g->start = nt;
@@ -83,6 +88,9 @@ HCFGrammar *h_cfgrammar_(HAllocator* mm__, HCFChoice *desugared)
   // determine which nonterminals generate epsilon
   collect_geneps(g);
 
+  // partition the input alphabet
+  collect_bclasses(g);
+
   return g;
 }
 
@@ -124,6 +132,74 @@ static void collect_nts(HCFGrammar *grammar, HCFChoice *symbol)
   }
 }
 
+/* Split the byte classes in cls (numbered 0..n-1) such that no class has
+ * members both in and outside of the set given by the predicate.
+ * Returns the new number of classes.
+ */
+static size_t refine_bclasses(uint8_t *cls, size_t n,
+                              bool (*member)(const HCFChoice *, uint8_t),
+                              const HCFChoice *x)
+{
+  int newcls[256][2];
+  size_t m = 0;
+
+  for(size_t k=0; k<n; k++)
+    newcls[k][0] = newcls[k][1] = -1;
+  for(unsigned int c=0; c<256; c++) {
+    int *nc = &newcls[cls[c]][member(x, c)];
+    if(*nc < 0)
+      *nc = m++;
+    cls[c] = *nc;
+  }
+
+  return m;
+}
+
+static bool charset_member(const HCFChoice *x, uint8_t c)
+{
+  return charset_isset(x->charset, c);
+}
+
+static bool char_member(const HCFChoice *x, uint8_t c)
+{
+  return (x->chr == c);
+}
+
+/* Compute g->bclass by refining the trivial partition of all 256 bytes with
+ * every character and charset occuring in the grammar.
+ */
+static void collect_bclasses(HCFGrammar *g)
+{
+  uint8_t cls[256] = {0};
+  size_t n = 1;
+
+  // iterate over g->nts
+  for(size_t i=0; i < g->nts->capacity; i++) {
+    for(HHashTableEntry *hte = &g->nts->contents[i]; hte; hte = hte->next) {
+      if(hte->key == NULL)
+        continue;
+      const HCFChoice *a = hte->key;
+      assert(a->type == HCF_CHOICE);
+
+      for(HCFSequence **p=a->seq; *p; p++) {
+        for(HCFChoice **x=(*p)->items; *x && n<256; x++) {
+          if((*x)->type == HCF_CHAR)
+            n = refine_bclasses(cls, n, char_member, *x);
+          else if((*x)->type == HCF_CHARSET)
+            n = refine_bclasses(cls, n, charset_member, *x);
+        }
+      }
+    }
+  }
+
+  // map each byte to the smallest member of its class
+  uint8_t rep[256];
+  for(int c=255; c>=0; c--)
+    rep[cls[c]] = c;
+  for(unsigned int c=0; c<256; c++)
+    g->bclass[c] = rep[cls[c]];
+}
+
 /* Increase g->kmax if needed, allocating enough first/follow slots. */
 static void ensure_k(HCFGrammar *g, size_t k)
 {
@@ -224,6 +300,71 @@ static void collect_geneps(HCFGrammar *g)
   } while(g->geneps->used != prevused);
 }
 
+// is the value of x observed only in a form that does not depend on how the
+// values of its repetitions are nested? that is the case if every production
+// using x flattens its result or throws x's value away.
+static bool value_flattened(HCFGrammar *g, const HCFChoice *x)
+{
+  if(x == g->start)
+    return false;
+
+  for(size_t i=0; i < g->nts->capacity; i++) {
+    for(HHashTableEntry *hte = &g->nts->contents[i]; hte; hte = hte->next) {
+      if(hte->key == NULL)
+        continue;
+      const HCFChoice *a = hte->key;
+      if(a == x)
+        continue;
+
+      for(HCFSequence **p=a->seq; *p; p++) {
+        for(HCFChoice **y=(*p)->items; *y; y++) {
+          if(*y != x)
+            continue;
+          if(a->reshape == h_act_flatten || a->reshape == h_act_ignore)
+            continue;
+          if(a->reshape == h_act_last && y[1] != NULL)
+            continue;
+          return false;
+        }
+      }
+    }
+  }
+
+  return true;
+}
+
+const HCFChoice *h_span_terminal(HCFGrammar *g, const HCFChoice *x)
+{
+  if(x->type != HCF_CHOICE || x->reshape || x->action || x->pred)
+    return NULL;
+
+  // exactly the productions "x -> t x" and "x -> ", in either order
+  HCFSequence **p = x->seq;
+  if(!p[0] || !p[1] || p[2])
+    return NULL;
+  HCFChoice **loop = p[0]->items, **empty = p[1]->items;
+  if(loop[0] == NULL) {
+    empty = loop;
+    loop = p[1]->items;
+  }
+  if(empty[0] != NULL)
+    return NULL;
+  if(!loop[0] || loop[1] != x || loop[2])
+    return NULL;
+
+  // t must be a plain terminal. NB: the LR backends treat charsets as
+  // nonterminals and give them h_act_first to unwrap the single byte.
+  const HCFChoice *t = loop[0];
+  if(t->type != HCF_CHAR && t->type != HCF_CHARSET)
+    return NULL;
+  if(t->reshape && !(t->type == HCF_CHARSET && t->reshape == h_act_first))
+    return NULL;
+  if(t->action || t->pred)
+    return NULL;
+
+  return value_flattened(g, x)? t : NULL;
+}
+
 
 HStringMap *h_stringmap_new(HArena *a)
 {
@@ -321,7 +462,10 @@ void *h_stringmap_get(const HStringMap *m, const uint8_t *str, size_t n, bool en
   return m->epsilon_branch;
 }
 
-void *h_stringmap_get_lookahead(const HStringMap *m, HInputStream lookahead)
+// look up the longest match of the input in a lookahead map. input bytes are
+// mapped through bclass first (cf. HCFGrammar).
+void *h_stringmap_get_lookahead(const HStringMap *m, const uint8_t *bclass,
+                                HInputStream lookahead)
 {
   while(m) {
     if(m->epsilon_branch) {     // input matched
@@ -340,7 +484,7 @@ void *h_stringmap_get_lookahead(const HStringMap *m, HInputStream lookahead)
     }
 
     // no match yet, descend
-    m = h_stringmap_get_char(m, c);
+    m = h_stringmap_get_char(m, bclass[c]);
   }
 
   return NULL;
@@ -387,12 +531,14 @@ const HStringMap *h_first(size_t k, HCFGrammar *g, const HCFChoice *x)
     h_stringmap_put_end(ret, INSET);
     break;
   case HCF_CHAR:
+    assert(h_byteclass_rep(g->bclass, x->chr));
     h_stringmap_put_char(ret, x->chr, INSET);
     break;
   case HCF_CHARSET:
+    // only the representatives of the byte classes in charset
     c=0;
     do {
-      if(charset_isset(x->charset, c)) {
+      if(charset_isset(x->charset, c) && h_byteclass_rep(g->bclass, c)) {
         h_stringmap_put_char(ret, c, INSET);
       }
     } while(c++ < 255);
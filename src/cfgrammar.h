@@ -11,6 +11,7 @@ typedef struct HCFGrammar_ {
   HHashTable  **first;  // memoized first sets of the grammar's symbols
   HHashTable  **follow; // memoized follow sets of the grammar's NTs
   size_t      kmax;     // maximum lookahead depth allocated
+  uint8_t     bclass[256];  // maps bytes to their classes, see below
   HArena      *arena;
   HAllocator  *mm__;
 
@@ -27,6 +28,17 @@ typedef uintptr_t HCharKey;
 static inline HCharKey char_key(uint8_t c) { return (0x100 | c); }
 static inline uint8_t key_char(HCharKey k) { return (0xFF & k); }
 
+/* Byte equivalence classes.
+ * Two bytes are equivalent if no character or charset in the grammar
+ * distinguishes them. Each class is represented by its smallest member and
+ * g->bclass maps every byte to that representative. First/follow sets and
+ * the parse tables derived from them only contain representatives, so input
+ * must be mapped through bclass before it is looked up in them.
+ * NB: A byte used as a plain character forms a class by itself.
+ */
+static inline bool h_byteclass_rep(const uint8_t *bclass, uint8_t c)
+ { return (bclass[c] == c); }
+
 /* Mapping strings of input tokens to arbitrary values (or serving as a set).
  * Common prefixes are folded into a tree of HHashTables, branches labeled with
  * input tokens.
@@ -47,7 +59,8 @@ void h_stringmap_put_char(HStringMap *m, uint8_t c, void *v);
 void h_stringmap_update(HStringMap *m, const HStringMap *n);
 void h_stringmap_replace(HStringMap *m, void *old, void *new);
 void *h_stringmap_get(const HStringMap *m, const uint8_t *str, size_t n, bool end);
-void *h_stringmap_get_lookahead(const HStringMap *m, HInputStream lookahead);
+void *h_stringmap_get_lookahead(const HStringMap *m, const uint8_t *bclass,
+                                HInputStream lookahead);
 bool h_stringmap_present(const HStringMap *m, const uint8_t *str, size_t n, bool end);
 bool h_stringmap_present_epsilon(const HStringMap *m);
 bool h_stringmap_empty(const HStringMap *m);
@@ -76,6 +89,15 @@ bool h_derives_epsilon(HCFGrammar *g, const HCFChoice *symbol);
 /* Does the sentential form s derive the empty string? s NULL-terminated. */
 bool h_derives_epsilon_seq(HCFGrammar *g, HCFChoice **s);
 
+/* Is x a loop over a single terminal t, i.e. are its productions exactly
+ *   x -> t x
+ *     -> ""
+ * and is its value only observed in flattened form? If so, return t.
+ * Drivers can then consume a whole run of t in one step and give x the flat
+ * sequence of the terminals' values instead of the nested one.
+ */
+const HCFChoice *h_span_terminal(HCFGrammar *g, const HCFChoice *x);
+
 /* Compute first_k set of symbol x. Memoized. */
 const HStringMap *h_first(size_t k, HCFGrammar *g, const HCFChoice *x);
 
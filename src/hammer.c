@@ -48,7 +48,7 @@ typedef struct {
 HParseResult* h_parse(const HParser* parser, const uint8_t* input, size_t length) {
   return h_parse__m(&system_allocator, parser, input, length);
 }
-HParseResult* h_parse__m(HAllocator* mm__, const HParser* parser, const uint8_t* input, size_t length) {
+static HParseResult* parse_in(HAllocator* mm__, const HParser* parser, const uint8_t* input, size_t length, HArena *arena) {
   // Set up a parse state...
   HInputStream input_stream = {
     .index = 0,
@@ -59,7 +59,14 @@ HParseResult* h_parse__m(HAllocator* mm__, const HParser* parser, const uint8_t*
     .input = input
   };
   
-  return backends[parser->backend]->parse(mm__, parser, &input_stream);
+  return backends[parser->backend]->parse(mm__, parser, &input_stream, arena);
+}
+HParseResult* h_parse__m(HAllocator* mm__, const HParser* parser, const uint8_t* input, size_t length) {
+  return parse_in(mm__, parser, input, length, NULL);
+}
+
+HParseResult* h_parse_nested(const HParseResult *parent, const HParser* parser, const uint8_t* input, size_t length) {
+  return parse_in(h_arena_allocator(parent->arena), parser, input, length, parent->arena);
 }
 
 void h_parse_result_free__m(HAllocator *alloc, HParseResult *result) {
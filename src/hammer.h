@@ -76,6 +76,19 @@ typedef struct HBytes_ {
   size_t len;
 } HBytes;
 
+/**
+ * The value of h_packed_many and h_packed_repeat_n: len integers, each
+ * width bytes wide, stored one after another in host byte order and
+ * aligned for their width. Read them through the pointer type that
+ * matches width (uint16_t * for 2, and so on), signed if signedp.
+ */
+typedef struct HPackedArray_ {
+  size_t len;
+  uint8_t width;
+  bool signedp;
+  void *elements;
+} HPackedArray;
+
 #ifdef SWIG
 typedef union {
   HBytes bytes;
@@ -188,6 +201,7 @@ typedef struct HCaseResult_ {
 typedef struct HBackendResults_ {
   HParserBackend backend;
   bool compile_success;
+  size_t compile_time; // time to compile the grammar, in nsec
   size_t n_testcases;
   size_t failed_testcases; // actually a count...
   HCaseResult *cases;
@@ -252,6 +266,17 @@ typedef struct HBenchmarkResults_ {
  */
 HAMMER_FN_DECL(HParseResult*, h_parse, const HParser* parser, const uint8_t* input, size_t length);
 
+/**
+ * Call a parser on another piece of input while working on the result of
+ * a parse, e.g. from a semantic action given that result, to decode an
+ * inner layer of a protocol. The new result is allocated in the arena of
+ * parent and lives as long as parent does; do not free it separately.
+ * Temporary parse state comes from scratch space that the arena recycles
+ * from one nested parse to the next (except for the packrat backend, which
+ * keeps its memo table with the results), so no arena is created per layer.
+ */
+HParseResult* h_parse_nested(const HParseResult *parent, const HParser* parser, const uint8_t* input, size_t length);
+
 /**
  * Given a string, returns a parser that parses that string value. 
  * 
@@ -259,6 +284,63 @@ HAMMER_FN_DECL(HParseResult*, h_parse, const HParser* parser, const uint8_t* inp
  */
 HAMMER_FN_DECL(HParser*, h_token, const uint8_t *str, const size_t len);
 
+/**
+ * Given an array of n NUL-terminated words, returns a parser that parses
+ * any one of them, like a choice of h_token's. The packrat backend takes
+ * the longest word the input starts with, at one table lookup per byte
+ * however many words there are, and fails rather than try a shorter one.
+ * The other backends parse the words as a single trie and may take any
+ * word the rest of the parse allows: h_sequence(h_token_set({"a", "ab"}),
+ * h_ch('b')) fails on "ab" under packrat, takes "a" under the regex and
+ * GLR backends, and does not compile for LL(k) or LALR. The result is the
+ * word as it was given.
+ *
+ * Result token type: TT_BYTES
+ */
+HAMMER_FN_DECL(HParser*, h_token_set, const char **words, size_t n);
+
+/**
+ * Like h_token_set, but ASCII letters in the input match regardless of
+ * case.
+ *
+ * Result token type: TT_BYTES
+ */
+HAMMER_FN_DECL(HParser*, h_token_set_nocase, const char **words, size_t n);
+
+/**
+ * Returns a parser that parses the next n bytes, whatever they are. At a byte
+ * boundary the result points into the input; nothing is copied.
+ *
+ * Result token type: TT_BYTES
+ */
+HAMMER_FN_DECL(HParser*, h_bytes, size_t n);
+
+/**
+ * Returns a parser that skips the next n bytes.
+ *
+ * Result token type: None. The HParseResult exists but its AST is NULL.
+ */
+HAMMER_FN_DECL(HParser*, h_skip, size_t n);
+
+/**
+ * Given a delimiter string, returns a parser that parses all input up to
+ * (not including) the first occurrence of the delimiter, which must occur.
+ * The result points into the input. The input must be at a byte boundary.
+ * Only the packrat backend supports this parser.
+ *
+ * Result token type: TT_BYTES
+ */
+HAMMER_FN_DECL(HParser*, h_until, const uint8_t *delim, const size_t len);
+
+/**
+ * Returns a parser that parses the longest run (perhaps empty) of
+ * well-formed UTF-8 characters. The result points into the input. In the
+ * packrat backend the input must be at a byte boundary.
+ *
+ * Result token type: TT_BYTES
+ */
+HAMMER_FN_DECL_NOARG(HParser*, h_utf8_span);
+
 /**
  * Given a single character, returns a parser that parses that 
  * character. 
@@ -347,6 +429,48 @@ HAMMER_FN_DECL_NOARG(HParser*, h_uint16);
  */
 HAMMER_FN_DECL_NOARG(HParser*, h_uint8);
 
+/**
+ * Returns a parser that parses one or more ASCII decimal digits and
+ * gives their value. Fails if the value does not fit in 64 bits.
+ *
+ * Result token type: TT_UINT
+ */
+HAMMER_FN_DECL_NOARG(HParser*, h_decimal_uint);
+
+/**
+ * Like h_decimal_uint, but with an optional leading '+' or '-'. Fails if
+ * the value does not fit in an int64_t.
+ *
+ * Result token type: TT_SINT
+ */
+HAMMER_FN_DECL_NOARG(HParser*, h_decimal_int);
+
+/**
+ * Like h_decimal_uint, for hexadecimal digits in either case, without
+ * any "0x" prefix.
+ *
+ * Result token type: TT_UINT
+ */
+HAMMER_FN_DECL_NOARG(HParser*, h_hex_uint);
+
+/**
+ * Returns a parser that parses an unsigned LEB128 varint (as in protocol
+ * buffers): 7 bits per byte, least significant first, with the high bit
+ * set on all but the last byte. Fails if the value does not fit in 64
+ * bits.
+ *
+ * Result token type: TT_UINT
+ */
+HAMMER_FN_DECL_NOARG(HParser*, h_varint_u64);
+
+/**
+ * Like h_varint_u64, for a signed value in zigzag encoding (0, -1, 1,
+ * -2, ... as 0, 1, 2, 3, ...).
+ *
+ * Result token type: TT_SINT
+ */
+HAMMER_FN_DECL_NOARG(HParser*, h_varint_s64);
+
 /**
  * Given another parser, p, returns a parser that skips any whitespace 
  * and then applies p. 
@@ -485,6 +609,18 @@ HAMMER_FN_DECL(HParser*, h_many1, const HParser* p);
  */
 HAMMER_FN_DECL(HParser*, h_repeat_n, const HParser* p, const size_t n);
 
+/**
+ * Like h_many and h_repeat_n, for p a fixed-width integer parser of 8, 16,
+ * 32 or 64 bits (h_uint16(), h_int32(), h_bits(64, false) and so on), but
+ * the integers are decoded in bulk into one array instead of a token each.
+ * Returns NULL if p is not such a parser. Only the packrat backend supports
+ * these parsers.
+ *
+ * Result token type: TT_USER (an HPackedArray)
+ */
+HAMMER_FN_DECL(HParser*, h_packed_many, const HParser* p);
+HAMMER_FN_DECL(HParser*, h_packed_repeat_n, const HParser* p, const size_t n);
+
 /**
  * Given a parser, p, this parser succeeds with the value p parsed or 
  * with an empty result. 
@@ -501,6 +637,28 @@ HAMMER_FN_DECL(HParser*, h_optional, const HParser* p);
  */
 HAMMER_FN_DECL(HParser*, h_ignore, const HParser* p);
 
+/**
+ * Given a parser, p, this parser succeeds if p succeeds, and returns the
+ * input p consumed as a single byte string. The string points into the
+ * input buffer; nothing is copied. p's own result is discarded, so p's
+ * semantic actions may not run. The GLR backend skips building that result,
+ * and so does packrat when p is h_many or h_many1 of h_ch_range, h_in or
+ * h_not_in, whose run of bytes it scans directly. Otherwise packrat, LL(k)
+ * and LALR build all of p's AST and then drop it. p must start and end on a
+ * byte boundary, or the parse fails.
+ *
+ * Result token type: TT_BYTES
+ */
+HAMMER_FN_DECL(HParser*, h_capture, const HParser* p);
+
+/**
+ * Like h_capture, but fails unless the input p consumed is well-formed
+ * UTF-8. Only the packrat backend supports this parser.
+ *
+ * Result token type: TT_BYTES
+ */
+HAMMER_FN_DECL(HParser*, h_utf8, const HParser* p);
+
 /**
  * Given a parser, p, and a parser for a separator, sep, this parser 
  * matches a (possibly empty) list of things that p can parse, 
@@ -531,13 +689,41 @@ HAMMER_FN_DECL_NOARG(HParser*, h_epsilon_p);
  * This parser applies its first argument to read an unsigned integer
  * value, then applies its second argument that many times. length 
  * should parse an unsigned integer value; this is checked at runtime.
- * Specifically, the token_type of the returned token must be TT_UINT.
+ * Specifically, the token_type of the returned token must be TT_UINT,
+ * or the parse fails.
  * In future we might relax this to include TT_USER but don't count on it.
  *
  * Result token type: TT_SEQUENCE
  */
 HAMMER_FN_DECL(HParser*, h_length_value, const HParser* length, const HParser* value);
 
+/**
+ * This parser applies its first argument to read a byte count, n, then
+ * consumes a window of the next n bytes, whatever value does. length must
+ * return a TT_UINT token, and the input must be at a byte boundary, or the
+ * parse fails.
+ *
+ * value is applied to the window as if it were the whole input: it cannot
+ * read past the window's end, and h_end_p matches there. Whatever value
+ * leaves of the window is skipped. If value is NULL, or fails, the window
+ * is skipped without further work and returned as it is.
+ *
+ * Result token type: that of value if it succeeds, otherwise TT_BYTES
+ * (pointing into the input)
+ */
+HAMMER_FN_DECL(HParser*, h_length_window, const HParser* length, const HParser* value);
+
+/**
+ * Returns a parser that consumes the rest of the input without parsing it,
+ * and records where it started so that p can be applied there later, with
+ * h_force. Inside h_length_window, the rest of the input is the window.
+ * Only the packrat backend supports this parser.
+ *
+ * Result token type: a user token type of its own, registered as
+ * "com.upstandinghackers.hammer.lazy" (pass it to h_force)
+ */
+HAMMER_FN_DECL(HParser*, h_lazy, const HParser* p);
+
 /**
  * This parser attaches a predicate function, which returns true or 
  * false, to a parser. The function is evaluated over the parser's 
@@ -553,6 +739,27 @@ HAMMER_FN_DECL(HParser*, h_length_value, const HParser* length, const HParser* v
  */
 HAMMER_FN_DECL(HParser*, h_attr_bool, const HParser* p, HPredicate pred, void* user_data);
 
+/**
+ * Declare the precedence and associativity of p, for resolving
+ * shift/reduce conflicts in the LALR and GLR backends, like yacc's
+ * %left, %right and %nonassoc. Other backends parse p unchanged.
+ *
+ * Either wrap an operator, or an entire production:
+ *   h_sequence(E, h_left_assoc(h_ch('+'), 1), E, NULL)
+ *   h_left_assoc(h_sequence(E, h_ch('+'), E, NULL), 1)
+ * A production takes the precedence of its wrapper, or else that of the
+ * last wrapped symbol on its right-hand side. On a conflict between
+ * reducing a production and shifting a terminal that is part of another
+ * one, the higher level wins. On equal levels, h_left_assoc reduces,
+ * h_right_assoc shifts, and h_nonassoc makes the input an error. Levels
+ * start at 1.
+ *
+ * Result token type: p's result type
+ */
+HAMMER_FN_DECL(HParser*, h_left_assoc, const HParser* p, unsigned int level);
+HAMMER_FN_DECL(HParser*, h_right_assoc, const HParser* p, unsigned int level);
+HAMMER_FN_DECL(HParser*, h_nonassoc, const HParser* p, unsigned int level);
+
 /**
  * The 'and' parser asserts that a conditional syntax is satisfied, 
  * but doesn't consume that conditional syntax. 
@@ -612,6 +819,17 @@ HAMMER_FN_DECL(void, h_bind_indirect, HParser* indirect, const HParser* inner);
  */
 HAMMER_FN_DECL(void, h_parse_result_free, HParseResult *result);
 
+/**
+ * Apply the parser of an h_lazy token to the input it recorded, the first
+ * time it is asked to, and return the result, or NULL if the parse failed
+ * or thunk is not an h_lazy token. p is run by the packrat backend whatever
+ * backend it was compiled for, and defers actions if the parse that made the
+ * token did. The result is allocated in the arena of the result that holds
+ * the token, and lives as long as it does; do not free it separately. The
+ * input must still be around.
+ */
+HParseResult* h_force(const HParsedToken *thunk);
+
 // Some debugging aids
 /**
  * Format token into a compact unambiguous form. Useful for parser test cases.
@@ -624,6 +842,33 @@ char* h_write_result_unamb(const HParsedToken* tok);
  */
 void h_pprint(FILE* stream, const HParsedToken* tok, int indent, int delta);
 
+/**
+ * Parameters for the packrat backend (PB_PACKRAT), for use with h_compile.
+ *
+ * defer_actions: Do not call h_action functions while parsing, only on the
+ *   final parse tree once the parse is complete. Actions on alternatives
+ *   that are later abandoned never run. Validations (h_attr_bool) still
+ *   run during the parse; they see the results of the actions below them.
+ *
+ * The GLR backend always defers actions in this way.
+ */
+typedef struct HPackratParams_ {
+  bool defer_actions;
+} HPackratParams;
+
+/**
+ * Parameters for the LALR and GLR backends (PB_LALR, PB_GLR), for use with
+ * h_compile.
+ *
+ * lr1: If the LALR(1) tables have conflicts, build LR(1) tables instead.
+ *   States that LALR merges are kept apart where merging them would
+ *   introduce a conflict. Grammars that are LR(1) but not LALR(1) thus get
+ *   conflict-free tables. Takes more time and space to compile.
+ */
+typedef struct HLRParams_ {
+  bool lr1;
+} HLRParams;
+
 /**
  * Build parse tables for the given parser backend. See the
  * documentation for the parser backend in question for information
@@ -670,7 +915,7 @@ void h_benchmark_report(FILE* stream, HBenchmarkResults* results);
 // }}}
 
 // {{{ Token type registry
-/// Allocate a new, unused (as far as this function knows) token type.
+/// Allocate a new, unused (as far as this function knows) token type, above TT_USER.
 int h_allocate_token_type(const char* name);
 
 /// Get the token type associated with name. Returns -1 if name is unkown
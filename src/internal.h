@@ -69,6 +69,31 @@ typedef struct HInputStream_ {
   char overrun;
 } HInputStream;
 
+// load 64 bits from (unaligned) memory, as a little- or big-endian number
+static inline uint64_t h_load_le64(const uint8_t *p) {
+  uint64_t w;
+  memcpy(&w, p, sizeof(w));
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+  w = __builtin_bswap64(w);
+#endif
+  return w;
+}
+
+static inline uint64_t h_load_be64(const uint8_t *p) {
+  uint64_t w;
+  memcpy(&w, p, sizeof(w));
+#if !defined(__BYTE_ORDER__) || __BYTE_ORDER__ != __ORDER_BIG_ENDIAN__
+  w = __builtin_bswap64(w);
+#endif
+  return w;
+}
+
+// true at a byte boundary, where parsers consuming whole bytes may read
+// input[index] directly instead of calling h_read_bits.
+static inline bool h_input_aligned(const HInputStream *s) {
+  return (s->bit_offset & 7) == 0;
+}
+
 typedef struct HSlistNode_ {
   void* elem;
   struct HSlistNode_ *next;
@@ -157,6 +182,17 @@ static inline void charset_set(HCharset cs, uint8_t pos, int val) {
     : cs[pos / sizeof(*cs)] & ~(1 << (pos % sizeof(*cs)));
 }
 
+/* A charset prepared for h_read_span. If the set is made of at most
+ * H_SPAN_RANGES ranges of bytes, these are kept as well; they can be tested
+ * 16 or 32 bytes at a time.
+ */
+#define H_SPAN_RANGES 8
+typedef struct HSpanSet_ {
+  HCharset cs;          // may be NULL if nranges > 0
+  uint8_t nranges;      // 0 if the set has more ranges (or none)
+  uint8_t lo[H_SPAN_RANGES], hi[H_SPAN_RANGES];
+} HSpanSet;
+
 typedef unsigned int HHashValue;
 typedef HHashValue (*HHashFunc)(const void* key);
 typedef bool (*HEqualFunc)(const void* key1, const void* key2);
@@ -194,11 +230,18 @@ struct HParseState_ {
   HArena * arena;
   HSlist *lr_stack;
   HHashTable *recursion_heads;
+  bool defer_actions; // see HPackratParams
 };
 
+/* With deferred actions, h_action yields a token of this type that records
+ * the call to be made once the parse is complete.
+ */
+#define TT_DEFERRED TT_RESERVED_1
+
 typedef struct HParserBackendVTable_ {
   int (*compile)(HAllocator *mm__, HParser* parser, const void* params);
-  HParseResult* (*parse)(HAllocator *mm__, const HParser* parser, HInputStream* stream);
+  // results go in arena, or in a new one, deleted on failure, if it is NULL
+  HParseResult* (*parse)(HAllocator *mm__, const HParser* parser, HInputStream* stream, HArena *arena);
   void (*free)(HParser* parser);
 } HParserBackendVTable;
 
@@ -292,8 +335,31 @@ extern HParserBackendVTable h__glr_backend_vtable;
 // TODO(thequux): Set symbol visibility for these functions so that they aren't exported.
 
 int64_t h_read_bits(HInputStream* state, int count, char signed_p);
+int h_next_byte(const HInputStream *in, HInputStream *after);
+void h_span_set_init(HSpanSet *set, HCharset cs);
+size_t h_read_span(HInputStream* state, const HSpanSet *set);
+void h_read_packed(HInputStream* state, void *dst, size_t n, int width);
+size_t h_read_utf8(HInputStream* state);
 // need to decide if we want to make this public. 
 HParseResult* h_do_parse(const HParser* parser, HParseState *state);
+HParseResult* h_packrat_parse_arena(HArena *arena, const HParser* parser, HInputStream *stream, bool defer_actions);
+HAllocator *h_arena_allocator(HArena *arena);
+HArena *h_arena_scratch(HArena *arena);
+void h_arena_scratch_done(HArena *arena, HArena *scratch);
+
+// the temporary arena of a backend parse: borrowed from the result arena
+// it is given, if any, see h_parse_nested
+static inline HArena *h_parse_scratch(HAllocator *mm__, HArena *parent) {
+  return parent ? h_arena_scratch(parent) : h_new_arena(mm__, 0);
+}
+static inline void h_parse_scratch_done(HArena *parent, HArena *tarena) {
+  if (parent)
+    h_arena_scratch_done(parent, tarena);
+  else
+    h_delete_arena(tarena);
+}
+HParsedToken* h_defer_action(HParseState *state, HParseResult *res, HAction action, void *user_data);
+HParseResult* h_force_actions(HParseState *state, HParseResult *res);
 void put_cached(HParseState *ps, const HParser *p, HParseResult *cached);
 
 static inline
@@ -366,6 +432,13 @@ struct HCFChoice_ {
   HAction action;
   HPredicate pred;
   void* user_data;
+  unsigned int prec;  // precedence for resolving LR conflicts (0 = none),
+  enum HCFAssoc {     // see h_left_assoc
+    HCF_NONASSOC,
+    HCF_LEFT_ASSOC,
+    HCF_RIGHT_ASSOC
+  } assoc;
+  bool capture;       // value is the input covered, see h_capture
 };
 
 struct HCFSequence_ {
@@ -12,7 +12,9 @@ static HParseResult* parse_action(void *env, HParseState *state) {
   if (a->p && a->action) {
     HParseResult *tmp = h_do_parse(a->p, state);
     //HParsedToken *tok = a->action(h_do_parse(a->p, state));
-    if(tmp) {
+    if(tmp && state->defer_actions) {
+      return make_result(state->arena, h_defer_action(state, tmp, a->action, a->user_data));
+    } else if(tmp) {
       const HParsedToken *tok = a->action(tmp, a->user_data);
       return make_result(state->arena, (HParsedToken*)tok);
     } else
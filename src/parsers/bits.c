@@ -1,16 +1,23 @@
 #include <assert.h>
 #include "parser_internal.h"
 
-struct bits_env {
-  uint8_t length;
-  uint8_t signedp;
-};
-
 static HParseResult* parse_bits(void* env, HParseState *state) {
   struct bits_env *env_ = env;
+  HInputStream *in = &state->input_stream;
   HParsedToken *result = a_new(HParsedToken, 1);
   result->token_type = (env_->signedp ? TT_SINT : TT_UINT);
-  if (env_->signedp)
+  if (h_input_aligned(in) && env_->length % 8 == 0 && env_->length > 0
+      && env_->length <= 64 && in->length - in->index >= 8) {
+    // whole bytes: one load, shifted down to length bits
+    const uint8_t *p = in->input + in->index;
+    int shift = 64 - env_->length;
+    uint64_t w = (in->endianness & BYTE_BIG_ENDIAN) ? h_load_be64(p) : h_load_le64(p) << shift;
+    in->index += env_->length / 8;
+    if (env_->signedp)
+      result->sint = (int64_t)w >> shift;
+    else
+      result->uint = w >> shift;
+  } else if (env_->signedp)
     result->sint = h_read_bits(&state->input_stream, env_->length, true);
   else
     result->uint = h_read_bits(&state->input_stream, env_->length, false);
@@ -96,7 +103,7 @@ static bool bits_ctrvm(HRVMProg *prog, void* env) {
   return true;
 }
 
-static const HParserVtable bits_vt = {
+const HParserVtable h__bits_vt = {
   .parse = parse_bits,
   .isValidRegular = h_true,
   .isValidCF = h_true,
@@ -111,7 +118,7 @@ HParser* h_bits__m(HAllocator* mm__, size_t len, bool sign) {
   struct bits_env *env = h_new(struct bits_env, 1);
   env->length = len;
   env->signedp = sign;
-  return h_new_parser(mm__, &bits_vt, env);
+  return h_new_parser(mm__, &h__bits_vt, env);
 }
 
 #define SIZED_BITS(name_pre, len, signedp) \
@@ -0,0 +1,173 @@
+#include <assert.h>
+#include <string.h>
+#include "parser_internal.h"
+
+typedef struct {
+  size_t n;
+  bool skip;    // h_skip: no result
+} HBytesEnv;
+
+// whether n more whole bytes are available. in the middle of a byte, the
+// last of them extends into input[index + n].
+static bool bytes_available(const HInputStream *in, size_t n) {
+  size_t avail = in->length - in->index;
+  if (!h_input_aligned(in))
+    avail = avail > 0 ? avail - 1 : 0;
+  return avail >= n;
+}
+
+static HParseResult* parse_bytes(void *env, HParseState *state) {
+  HBytesEnv *b = (HBytesEnv*)env;
+  HInputStream *in = &state->input_stream;
+  if (!bytes_available(in, b->n))
+    return NULL;
+
+  if (b->skip) {
+    in->index += b->n;
+    HParseResult *res = a_new(HParseResult, 1);
+    res->ast = NULL;
+    res->arena = state->arena;
+    return res;
+  }
+
+  HParsedToken *tok = a_new(HParsedToken, 1);
+  tok->token_type = TT_BYTES;
+  tok->index = in->index;
+  tok->bit_offset = in->bit_offset;
+  tok->bytes.len = b->n;
+  if (h_input_aligned(in)) {
+    tok->bytes.token = in->input + in->index;
+    in->index += b->n;
+  } else {
+    // no bytes to point to; copy
+    uint8_t *buf = a_new(uint8_t, b->n);
+    for (size_t i = 0; i < b->n; i++)
+      buf[i] = h_read_bits(in, 8, false);
+    tok->bytes.token = buf;
+  }
+  return make_result(state->arena, tok);
+}
+
+static void desugar_bytes(HAllocator *mm__, HCFStack *stk__, void *env) {
+  HBytesEnv *b = (HBytesEnv*)env;
+  HCharset match_all = new_charset(mm__);
+  for (int i = 0; i < 256; i++)
+    charset_set(match_all, i, 1);
+  HCFS_BEGIN_CHOICE() {
+    HCFS_BEGIN_SEQ() {
+      for (size_t i = 0; i < b->n; i++)
+	HCFS_ADD_CHARSET(match_all);
+    } HCFS_END_SEQ();
+    if (b->skip)
+      HCFS_THIS_CHOICE->reshape = h_act_ignore;
+    else
+      HCFS_THIS_CHOICE->capture = true;   // see h_capture
+  } HCFS_END_CHOICE();
+}
+
+static bool bytes_ctrvm(HRVMProg *prog, void *env) {
+  HBytesEnv *b = (HBytesEnv*)env;
+  // two instructions a byte, and the program counter is 16 bits
+  size_t room = UINT16_MAX - h_rvm_get_ip(prog);
+  if (room < 2 || b->n > (room - 2) / 2)
+    return false;
+  if (!b->skip)
+    h_rvm_insert_insn(prog, RVM_PUSH, 0);
+  for (size_t i = 0; i < b->n; i++) {
+    h_rvm_insert_insn(prog, RVM_MATCH, 0xFF00);
+    h_rvm_insert_insn(prog, RVM_STEP, 0);
+  }
+  if (!b->skip)
+    h_rvm_insert_insn(prog, RVM_CAPTURE, 0);
+  return true;
+}
+
+static const HParserVtable bytes_vt = {
+  .parse = parse_bytes,
+  .isValidRegular = h_true,
+  .isValidCF = h_true,
+  .desugar = desugar_bytes,
+  .compile_to_rvm = bytes_ctrvm,
+};
+
+static HParser* bytes__m(HAllocator* mm__, size_t n, bool skip) {
+  HBytesEnv *env = h_new(HBytesEnv, 1);
+  env->n = n;
+  env->skip = skip;
+  return h_new_parser(mm__, &bytes_vt, env);
+}
+
+HParser* h_bytes(size_t n) {
+  return bytes__m(&system_allocator, n, false);
+}
+HParser* h_bytes__m(HAllocator* mm__, size_t n) {
+  return bytes__m(mm__, n, false);
+}
+
+HParser* h_skip(size_t n) {
+  return bytes__m(&system_allocator, n, true);
+}
+HParser* h_skip__m(HAllocator* mm__, size_t n) {
+  return bytes__m(mm__, n, true);
+}
+
+
+typedef struct {
+  uint8_t *delim;
+  size_t len;
+} HUntil;
+
+// find the first occurrence of delim in [p, end), or NULL
+static const uint8_t *find_delim(const uint8_t *p, const uint8_t *end,
+                                 const uint8_t *delim, size_t len) {
+  if (len == 0)
+    return p;
+  while ((size_t)(end - p) >= len) {
+    p = memchr(p, delim[0], end - p - len + 1);
+    if (!p)
+      return NULL;
+    if (memcmp(p + 1, delim + 1, len - 1) == 0)
+      return p;
+    p++;
+  }
+  return NULL;
+}
+
+static HParseResult* parse_until(void *env, HParseState *state) {
+  HUntil *u = (HUntil*)env;
+  HInputStream *in = &state->input_stream;
+  if (!h_input_aligned(in))
+    return NULL;
+  const uint8_t *p = in->input + in->index;
+  const uint8_t *q = find_delim(p, in->input + in->length, u->delim, u->len);
+  if (!q)
+    return NULL;
+
+  HParsedToken *tok = a_new(HParsedToken, 1);
+  tok->token_type = TT_BYTES;
+  tok->bytes.token = p;
+  tok->bytes.len = q - p;
+  tok->index = in->index;
+  tok->bit_offset = in->bit_offset;
+  in->index += q - p;
+  return make_result(state->arena, tok);
+}
+
+// stopping before the delimiter needs to look ahead at it, which neither the
+// regex VM nor the grammar of the CFG backends can express.
+static const HParserVtable until_vt = {
+  .parse = parse_until,
+  .isValidRegular = h_false,
+  .isValidCF = h_false,
+};
+
+HParser* h_until(const uint8_t *delim, const size_t len) {
+  return h_until__m(&system_allocator, delim, len);
+}
+HParser* h_until__m(HAllocator* mm__, const uint8_t *delim, const size_t len) {
+  HUntil *env = h_new(HUntil, 1);
+  env->delim = h_new(uint8_t, len);
+  memcpy(env->delim, delim, len);
+  env->len = len;
+  return h_new_parser(mm__, &until_vt, env);
+}
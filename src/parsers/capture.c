@@ -0,0 +1,90 @@
+#include <assert.h>
+#include "parser_internal.h"
+
+typedef struct {
+  const HParser *p;
+  const HSpanSet *span; // if p is h_many/h_many1 of a charset
+  size_t min;           // and the least length of its run
+} HCapture;
+
+static HParseResult* parse_capture(void* env, HParseState* state) {
+  HCapture *c = (HCapture*)env;
+  HInputStream *in = &state->input_stream;
+  if (!h_input_aligned(in))
+    return NULL;
+  size_t start = in->index;
+  if (c->span) {
+    // scan the run without building a token per byte
+    if (h_read_span(in, c->span) < c->min) {
+      in->index = start;
+      return NULL;
+    }
+  } else if (!h_do_parse(c->p, state) || !h_input_aligned(in)) {
+    return NULL;
+  }
+  HParsedToken *tok = a_new(HParsedToken, 1);
+  tok->token_type = TT_BYTES;
+  tok->bytes.token = in->input + start;
+  tok->bytes.len = in->index - start;
+  tok->index = start;
+  tok->bit_offset = in->bit_offset;
+  return make_result(state->arena, tok);
+}
+
+static bool capture_isValidRegular(void *env) {
+  const HParser *p = ((HCapture*)env)->p;
+  return (p->vtable->isValidRegular(p->env));
+}
+
+static bool capture_isValidCF(void *env) {
+  const HParser *p = ((HCapture*)env)->p;
+  return (p->vtable->isValidCF(p->env));
+}
+
+// the backends give a capturing choice the input it covers as its value, see
+// h_lr_reduce_value and h_llk_parse.
+static void desugar_capture(HAllocator *mm__, HCFStack *stk__, void *env) {
+  HCFS_BEGIN_CHOICE() {
+    HCFS_BEGIN_SEQ() {
+      HCFS_DESUGAR( ((HCapture*)env)->p );
+    } HCFS_END_SEQ();
+    HCFS_THIS_CHOICE->capture = true;
+  } HCFS_END_CHOICE();
+}
+
+// drop whatever p left above the mark, which SVM_CAPTURE then turns into the
+// bytes it covers
+static bool h_svm_action_pop_to_mark(HArena *arena, HSVMContext *ctx, void* arg) {
+  while (ctx->stack_count > 0 && ctx->stack[ctx->stack_count-1]->token_type != TT_MARK)
+    ctx->stack_count--;
+  assert(ctx->stack_count > 0);
+  return true;
+}
+
+static bool capture_ctrvm(HRVMProg *prog, void *env) {
+  const HParser *p = ((HCapture*)env)->p;
+  h_rvm_insert_insn(prog, RVM_PUSH, 0);
+  if (!h_compile_regex(prog, p))
+    return false;
+  h_rvm_insert_insn(prog, RVM_ACTION, h_rvm_create_action(prog, h_svm_action_pop_to_mark, NULL));
+  h_rvm_insert_insn(prog, RVM_CAPTURE, 0);
+  return true;
+}
+
+static const HParserVtable capture_vt = {
+  .parse = parse_capture,
+  .isValidRegular = capture_isValidRegular,
+  .isValidCF = capture_isValidCF,
+  .desugar = desugar_capture,
+  .compile_to_rvm = capture_ctrvm,
+};
+
+HParser* h_capture(const HParser* p) {
+  return h_capture__m(&system_allocator, p);
+}
+HParser* h_capture__m(HAllocator* mm__, const HParser* p) {
+  HCapture *env = h_new(HCapture, 1);
+  env->p = p;
+  env->span = h_many_span(p, &env->min);
+  return h_new_parser(mm__, &capture_vt, env);
+}
@@ -4,7 +4,12 @@
 
 static HParseResult* parse_ch(void* env, HParseState *state) {
   uint8_t c = (uint8_t)(unsigned long)(env);
-  uint8_t r = (uint8_t)h_read_bits(&state->input_stream, 8, false);
+  HInputStream *in = &state->input_stream;
+  uint8_t r;
+  if (h_input_aligned(in) && in->index < in->length)
+    r = in->input[in->index++];
+  else
+    r = (uint8_t)h_read_bits(in, 8, false);
   if (c == r) {
     HParsedToken *tok = a_new(HParsedToken, 1);    
     tok->token_type = TT_UINT; tok->uint = r;
@@ -4,7 +4,12 @@
 #include "parser_internal.h"
 
 static HParseResult* parse_charset(void *env, HParseState *state) {
-  uint8_t in = h_read_bits(&state->input_stream, 8, false);
+  HInputStream *s = &state->input_stream;
+  uint8_t in;
+  if (h_input_aligned(s) && s->index < s->length)
+    in = s->input[s->index++];
+  else
+    in = h_read_bits(s, 8, false);
   HCharset cs = (HCharset)env;
 
   if (charset_isset(cs, in)) {
@@ -70,7 +75,7 @@ static bool cs_ctrvm(HRVMProg *prog, void *env) {
   return true;
 }
 
-static const HParserVtable charset_vt = {
+const HParserVtable h__charset_vt = {
   .parse = parse_charset,
   .isValidRegular = h_true,
   .isValidCF = h_true,
@@ -85,7 +90,7 @@ HParser* h_ch_range__m(HAllocator* mm__, const uint8_t lower, const uint8_t uppe
   HCharset cs = new_charset(mm__);
   for (int i = 0; i < 256; i++)
     charset_set(cs, i, (lower <= i) && (i <= upper));
-  return h_new_parser(mm__, &charset_vt, cs);
+  return h_new_parser(mm__, &h__charset_vt, cs);
 }
 
 
@@ -96,7 +101,7 @@ static HParser* h_in_or_not__m(HAllocator* mm__, const uint8_t *options, size_t
   for (size_t i = 0; i < count; i++)
     charset_set(cs, options[i], val);
 
-  return h_new_parser(mm__, &charset_vt, cs);
+  return h_new_parser(mm__, &h__charset_vt, cs);
 }
 
 HParser* h_in(const uint8_t *options, size_t count) {
@@ -9,7 +9,7 @@ typedef struct {
 
 static HParseResult* parse_int_range(void *env, HParseState *state) {
   HRange *r_env = (HRange*)env;
-  HParseResult *ret = h_do_parse(r_env->p, state);
+  HParseResult *ret = h_force_actions(state, h_do_parse(r_env->p, state));
   if (!ret || !ret->ast)
     return NULL;
   switch(ret->ast->token_type) {
@@ -78,11 +78,6 @@ void gen_int_range(HAllocator *mm__, HCFStack *stk__, uint64_t low, uint64_t hig
   }
 }
 
-struct bits_env {
-  uint8_t length;
-  uint8_t signedp;
-};
-
 static void desugar_int_range(HAllocator *mm__, HCFStack *stk__, void *env) {
   HRange *r = (HRange*)env;
   struct bits_env* be = (struct bits_env*)r->p->env;
@@ -125,7 +120,7 @@ HParser* h_int_range(const HParser *p, const int64_t lower, const int64_t upper)
 HParser* h_int_range__m(HAllocator* mm__, const HParser *p, const int64_t lower, const int64_t upper) {
   // p must be an integer parser, which means it's using parse_bits
   // TODO: re-add this check
-  //assert_message(p->vtable == &bits_vt, "int_range requires an integer parser"); 
+  //assert_message(p->vtable == &h__bits_vt, "int_range requires an integer parser"); 
 
   // and regardless, the bounds need to fit in the parser in question
   // TODO: check this as well.
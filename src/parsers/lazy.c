@@ -0,0 +1,70 @@
+#include <assert.h>
+#include "parser_internal.h"
+
+// what h_lazy leaves behind: the rest of the input at the point it was
+// reached, and, once forced, the result of parsing it with p
+typedef struct {
+  const HParser *p;
+  HInputStream input;
+  HArena *arena;
+  bool defer_actions;   // as in the parse that reached it
+  bool forced;
+  HParseResult *result;
+} HLazy;
+
+// the token type of h_lazy tokens, so that h_force can tell them from other
+// TT_USER tokens
+static HTokenType lazy_token_type(void) {
+  static HTokenType tt = 0;
+  if (!tt)
+    tt = h_allocate_token_type("com.upstandinghackers.hammer.lazy");
+  return tt;
+}
+
+static HParseResult* parse_lazy(void *env, HParseState *state) {
+  HInputStream *in = &state->input_stream;
+  HLazy *lazy = a_new(HLazy, 1);
+  lazy->p = (const HParser*)env;
+  lazy->input = *in;
+  lazy->arena = state->arena;
+  lazy->defer_actions = state->defer_actions;
+  lazy->forced = false;
+  lazy->result = NULL;
+
+  HParsedToken *tok = a_new(HParsedToken, 1);
+  tok->token_type = lazy_token_type();
+  tok->user = lazy;
+  tok->index = in->index;
+  tok->bit_offset = in->bit_offset;
+  in->index = in->length;
+  in->bit_offset = (in->endianness & BIT_BIG_ENDIAN) ? 8 : 0;
+  return make_result(state->arena, tok);
+}
+
+// deferring p means not knowing where it ends, which only a backend that
+// parses by calling into the combinators can cope with
+static const HParserVtable lazy_vt = {
+  .parse = parse_lazy,
+  .isValidRegular = h_false,
+  .isValidCF = h_false,
+};
+
+HParser* h_lazy(const HParser* p) {
+  return h_lazy__m(&system_allocator, p);
+}
+HParser* h_lazy__m(HAllocator* mm__, const HParser* p) {
+  lazy_token_type();
+  return h_new_parser(mm__, &lazy_vt, (void *)p);
+}
+
+HParseResult* h_force(const HParsedToken *thunk) {
+  if (!thunk || thunk->token_type != lazy_token_type())
+    return NULL;
+  HLazy *lazy = (HLazy*)thunk->user;
+  if (!lazy->forced) {
+    HInputStream input = lazy->input;
+    lazy->result = h_packrat_parse_arena(lazy->arena, lazy->p, &input, lazy->defer_actions);
+    lazy->forced = true;
+  }
+  return lazy->result;
+}
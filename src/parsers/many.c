@@ -6,10 +6,38 @@ typedef struct {
   const HParser *p, *sep;
   size_t count;
   bool min_p;
+  const HSpanSet *span;   // if p is a charset parser and there is no sep
 } HRepeat;
 
+// h_many/h_many1 of a charset: scan the run of its bytes in one go.
+static HParseResult *parse_span(HRepeat *env_, HParseState *state) {
+  HInputStream *in = &state->input_stream;
+  size_t index = in->index;
+  size_t n = h_read_span(in, env_->span);
+  if (n < env_->count)
+    return NULL;
+
+  HCountedArray *seq = h_carray_new_sized(state->arena, n > 0 ? n : 4);
+  HParsedToken *toks = a_new(HParsedToken, n);
+  for (size_t i = 0; i < n; i++) {
+    toks[i].token_type = TT_UINT;
+    toks[i].uint = in->input[index + i];
+    toks[i].index = index + i;
+    toks[i].bit_offset = in->bit_offset;
+    seq->elements[i] = &toks[i];
+  }
+  seq->used = n;
+
+  HParsedToken *res = a_new(HParsedToken, 1);
+  res->token_type = TT_SEQUENCE;
+  res->seq = seq;
+  return make_result(state->arena, res);
+}
+
 static HParseResult *parse_many(void* env, HParseState *state) {
   HRepeat *env_ = (HRepeat*) env;
+  if (env_->span && h_input_aligned(&state->input_stream))
+    return parse_span(env_, state);
   HCountedArray *seq = h_carray_new_sized(state->arena, (env_->count > 0 ? env_->count : 4));
   size_t count = 0;
   HInputStream bak;
@@ -175,6 +203,14 @@ static const HParserVtable many_vt = {
   .compile_to_rvm = many_ctrvm,
 };
 
+static const HSpanSet *charset_span(HAllocator *mm__, const HParser *p) {
+  if (p->vtable != &h__charset_vt)
+    return NULL;
+  HSpanSet *span = h_new(HSpanSet, 1);
+  h_span_set_init(span, (HCharset)p->env);
+  return span;
+}
+
 HParser* h_many(const HParser* p) {
   return h_many__m(&system_allocator, p);
 }
@@ -184,6 +220,7 @@ HParser* h_many__m(HAllocator* mm__, const HParser* p) {
   env->sep = NULL;
   env->count = 0;
   env->min_p = true;
+  env->span = charset_span(mm__, p);
   return h_new_parser(mm__, &many_vt, env);
 }
 
@@ -196,9 +233,18 @@ HParser* h_many1__m(HAllocator* mm__, const HParser* p) {
   env->sep = NULL;
   env->count = 1;
   env->min_p = true;
+  env->span = charset_span(mm__, p);
   return h_new_parser(mm__, &many_vt, env);
 }
 
+const HSpanSet *h_many_span(const HParser *p, size_t *min) {
+  if (p->vtable != &many_vt)
+    return NULL;
+  const HRepeat *repeat = (const HRepeat*)p->env;
+  *min = repeat->count;
+  return repeat->span;
+}
+
 HParser* h_repeat_n(const HParser* p, const size_t n) {
   return h_repeat_n__m(&system_allocator, p, n);
 }
@@ -208,6 +254,7 @@ HParser* h_repeat_n__m(HAllocator* mm__, const HParser* p, const size_t n) {
   env->sep = NULL;
   env->count = n;
   env->min_p = false;
+  env->span = NULL;
   return h_new_parser(mm__, &many_vt, env);
 }
 
@@ -220,6 +267,7 @@ HParser* h_sepBy__m(HAllocator* mm__, const HParser* p, const HParser* sep) {
   env->sep = sep;
   env->count = 0;
   env->min_p = true;
+  env->span = NULL;
   return h_new_parser(mm__, &many_vt, env);
 }
 
@@ -232,6 +280,7 @@ HParser* h_sepBy1__m(HAllocator* mm__, const HParser* p, const HParser* sep) {
   env->sep = sep;
   env->count = 1;
   env->min_p = true;
+  env->span = NULL;
   return h_new_parser(mm__, &many_vt, env);
 }
 
@@ -242,17 +291,16 @@ typedef struct {
 
 static HParseResult* parse_length_value(void *env, HParseState *state) {
   HLenVal *lv = (HLenVal*)env;
-  HParseResult *len = h_do_parse(lv->length, state);
-  if (!len)
+  HParseResult *len = h_force_actions(state, h_do_parse(lv->length, state));
+  if (!len || !len->ast || len->ast->token_type != TT_UINT)
     return NULL;
-  if (len->ast->token_type != TT_UINT)
-    errx(1, "Length parser must return an unsigned integer");
   // TODO: allocate this using public functions
   HRepeat repeat = {
     .p = lv->value,
     .sep = NULL,
     .count = len->ast->uint,
-    .min_p = false
+    .min_p = false,
+    .span = NULL
   };
   return parse_many(&repeat, state);
 }
@@ -272,3 +320,52 @@ HParser* h_length_value__m(HAllocator* mm__, const HParser* length, const HParse
   env->value = value;
   return h_new_parser(mm__, &length_value_vt, env);
 }
+
+static HParseResult* parse_length_window(void *env, HParseState *state) {
+  HLenVal *lv = (HLenVal*)env;
+  HParseResult *len = h_force_actions(state, h_do_parse(lv->length, state));
+  if (!len || !len->ast || len->ast->token_type != TT_UINT)
+    return NULL;
+  HInputStream *in = &state->input_stream;
+  if (!h_input_aligned(in) || len->ast->uint > in->length - in->index)
+    return NULL;
+
+  // parse the value in a stream that ends with the window. the stream's
+  // length is part of the packrat cache key, so results from inside the
+  // window are not confused with those from outside.
+  HInputStream outer = *in;
+  size_t end = in->index + len->ast->uint;
+  HParseResult *res = NULL;
+  if (lv->value) {
+    in->length = end;
+    res = h_do_parse(lv->value, state);
+  }
+  *in = outer;
+  in->index = end;
+  if (res)
+    return make_result(state->arena, (HParsedToken*)res->ast);
+
+  HParsedToken *tok = a_new(HParsedToken, 1);
+  tok->token_type = TT_BYTES;
+  tok->bytes.token = outer.input + outer.index;
+  tok->bytes.len = end - outer.index;
+  tok->index = outer.index;
+  tok->bit_offset = outer.bit_offset;
+  return make_result(state->arena, tok);
+}
+
+static const HParserVtable length_window_vt = {
+  .parse = parse_length_window,
+  .isValidRegular = h_false,
+  .isValidCF = h_false,
+};
+
+HParser* h_length_window(const HParser* length, const HParser* value) {
+  return h_length_window__m(&system_allocator, length, value);
+}
+HParser* h_length_window__m(HAllocator* mm__, const HParser* length, const HParser* value) {
+  HLenVal *env = h_new(HLenVal, 1);
+  env->length = length;
+  env->value = value;
+  return h_new_parser(mm__, &length_window_vt, env);
+}
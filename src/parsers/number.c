@@ -0,0 +1,245 @@
+#include <assert.h>
+#include "parser_internal.h"
+
+typedef struct {
+  int base;             // 10 or 16
+  bool sign;            // h_decimal_int: an optional sign, and TT_SINT
+  HParser *grammar;     // the same language, spelled out for the other backends
+} HNumber;
+
+#define SWAR_ONES  0x0101010101010101ULL
+#define SWAR_HIGHS 0x8080808080808080ULL
+
+// the high bit of each byte of x that is strictly between m and n, for
+// m < 128 and n <= 128
+static inline uint64_t swar_between(uint64_t x, uint8_t m, uint8_t n) {
+  uint64_t low7 = x & (SWAR_ONES * 127);
+  return (SWAR_ONES * (127 + n) - low7) & ~x & (low7 + SWAR_ONES * (127 - m)) & SWAR_HIGHS;
+}
+
+static inline uint64_t swar_hex_letters(uint64_t x) {
+  return swar_between(x, 'A' - 1, 'F' + 1) | swar_between(x, 'a' - 1, 'f' + 1);
+}
+
+static inline uint64_t swar_digits(uint64_t x, int base) {
+  uint64_t d = swar_between(x, '0' - 1, '9' + 1);
+  return base == 16 ? d | swar_hex_letters(x) : d;
+}
+
+// the value of 8 digits, the first in the low byte of x. shifting x up
+// first puts leading zeros (as 0 bytes) in front.
+static inline uint64_t swar_decimal(uint64_t x) {
+  x = ((x & 0x0F0F0F0F0F0F0F0FULL) * 2561) >> 8;
+  x = ((x & 0x00FF00FF00FF00FFULL) * 6553601) >> 16;
+  return ((x & 0x0000FFFF0000FFFFULL) * 42949672960001ULL) >> 32;
+}
+
+static inline uint64_t swar_hex(uint64_t x) {
+  // a-f and A-F have 1-6 in their low nibble
+  x = (x & 0x0F0F0F0F0F0F0F0FULL) + (swar_hex_letters(x) >> 7) * 9;
+  x = ((x & 0x00FF00FF00FF00FFULL) << 4) | ((x >> 8) & 0x00FF00FF00FF00FFULL);
+  x = ((x & 0x0000FFFF0000FFFFULL) << 8) | ((x >> 16) & 0x0000FFFF0000FFFFULL);
+  return ((x & 0xFFFFFFFFULL) << 16) | (x >> 32);
+}
+
+static int digit_value(int c, int base) {
+  if (c >= '0' && c <= '9')
+    return c - '0';
+  if (base == 16 && (c | 0x20) >= 'a' && (c | 0x20) <= 'f')
+    return (c | 0x20) - 'a' + 10;
+  return -1;
+}
+
+static const uint64_t powers_of_10[] = {
+  1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000
+};
+
+// append k digits of value c to *v; false on overflow
+static inline bool append_digits(uint64_t *v, uint64_t c, int k, int base) {
+  if (base == 16) {
+    if (*v >> (64 - 4 * k))
+      return false;
+    *v = (*v << (4 * k)) | c;
+    return true;
+  }
+  return !__builtin_mul_overflow(*v, powers_of_10[k], v)
+      && !__builtin_add_overflow(*v, c, v);
+}
+
+// consume the longest run of digits; false if their value overflows
+static bool read_digits(HInputStream *in, int base, uint64_t *value, size_t *count) {
+  uint64_t v = 0;
+  size_t n = 0;
+  if (h_input_aligned(in)) {
+    const uint8_t *p = in->input + in->index;
+    const uint8_t *end = in->input + in->length;
+    // 8 bytes at a time, up to the first that is not a digit
+    for (; end - p >= 8; p += 8, n += 8) {
+      uint64_t w = h_load_le64(p);
+      uint64_t stop = ~swar_digits(w, base) & SWAR_HIGHS;
+      int k = stop ? __builtin_ctzll(stop) / 8 : 8;
+      if (k > 0) {
+        uint64_t x = w << (8 * (8 - k));
+        if (!append_digits(&v, base == 16 ? swar_hex(x) : swar_decimal(x), k, base))
+          return false;
+      }
+      if (k < 8) {
+        p += k;
+        n += k;
+        goto done;
+      }
+    }
+    for (int d; p < end && (d = digit_value(*p, base)) >= 0; p++, n++) {
+      if (!append_digits(&v, d, 1, base))
+        return false;
+    }
+  done:
+    in->index = p - in->input;
+  } else {
+    HInputStream after;
+    for (int c, d; (c = h_next_byte(in, &after)) >= 0 && (d = digit_value(c, base)) >= 0; n++) {
+      if (!append_digits(&v, d, 1, base))
+        return false;
+      *in = after;
+    }
+  }
+  *value = v;
+  *count = n;
+  return true;
+}
+
+static HParseResult* parse_number(void *env, HParseState *state) {
+  HNumber *num = (HNumber*)env;
+  HInputStream *in = &state->input_stream;
+  HParsedToken *tok = a_new(HParsedToken, 1);
+  tok->index = in->index;
+  tok->bit_offset = in->bit_offset;
+
+  bool neg = false;
+  if (num->sign) {
+    HInputStream after;
+    int c = h_next_byte(in, &after);
+    if (c == '-' || c == '+') {
+      neg = (c == '-');
+      *in = after;
+    }
+  }
+  uint64_t v;
+  size_t n;
+  if (!read_digits(in, num->base, &v, &n) || n == 0)
+    return NULL;
+
+  if (num->sign) {
+    if (v > (neg ? (uint64_t)INT64_MAX + 1 : (uint64_t)INT64_MAX))
+      return NULL;
+    tok->token_type = TT_SINT;
+    tok->sint = neg ? (int64_t)(0 - v) : (int64_t)v;
+  } else {
+    tok->token_type = TT_UINT;
+    tok->uint = v;
+  }
+  return make_result(state->arena, tok);
+}
+
+// fold what the grammar parsed, like parse_number; false on overflow
+static bool fold_number(const HNumber *num, const HParsedToken *ast, HParsedToken *out) {
+  const HCountedArray *digits = ast->seq;
+  bool neg = false;
+  if (num->sign) {
+    // [sign] digits; an absent sign may be TT_NONE or left out
+    const HParsedToken *sign = ast->seq->elements[0];
+    neg = (sign && sign->token_type == TT_UINT && sign->uint == '-');
+    digits = ast->seq->elements[ast->seq->used - 1]->seq;
+  }
+  uint64_t v = 0;
+  for (size_t i = 0; i < digits->used; i++) {
+    if (!append_digits(&v, digit_value(digits->elements[i]->uint, num->base), 1, num->base))
+      return false;
+  }
+  if (num->sign) {
+    if (v > (neg ? (uint64_t)INT64_MAX + 1 : (uint64_t)INT64_MAX))
+      return false;
+    out->token_type = TT_SINT;
+    out->sint = neg ? (int64_t)(0 - v) : (int64_t)v;
+  } else {
+    out->token_type = TT_UINT;
+    out->uint = v;
+  }
+  return true;
+}
+
+static bool number_fits(HParseResult *p, void *env) {
+  HParsedToken tok;
+  return fold_number((const HNumber*)env, p->ast, &tok);
+}
+
+static HParsedToken* act_number(const HParseResult *p, void *env) {
+  HParsedToken *tok = a_new_(p->arena, HParsedToken, 1);
+  fold_number((const HNumber*)env, p->ast, tok);
+  tok->index = p->ast->index;
+  tok->bit_offset = p->ast->bit_offset;
+  return tok;
+}
+
+static bool number_isValidRegular(void *env) {
+  HNumber *num = (HNumber*)env;
+  return num->grammar->vtable->isValidRegular(num->grammar->env);
+}
+
+static bool number_isValidCF(void *env) {
+  HNumber *num = (HNumber*)env;
+  return num->grammar->vtable->isValidCF(num->grammar->env);
+}
+
+static void desugar_number(HAllocator *mm__, HCFStack *stk__, void *env) {
+  HNumber *num = (HNumber*)env;
+  HCFS_DESUGAR(num->grammar);
+}
+
+static bool number_ctrvm(HRVMProg *prog, void *env) {
+  HNumber *num = (HNumber*)env;
+  return h_compile_regex(prog, num->grammar);
+}
+
+static const HParserVtable number_vt = {
+  .parse = parse_number,
+  .isValidRegular = number_isValidRegular,
+  .isValidCF = number_isValidCF,
+  .desugar = desugar_number,
+  .compile_to_rvm = number_ctrvm,
+};
+
+static HParser* number__m(HAllocator* mm__, int base, bool sign) {
+  HNumber *num = h_new(HNumber, 1);
+  num->base = base;
+  num->sign = sign;
+  HParser *digit = (base == 16)
+    ? h_in__m(mm__, (const uint8_t*)"0123456789abcdefABCDEF", 22)
+    : h_ch_range__m(mm__, '0', '9');
+  HParser *body = h_many1__m(mm__, digit);
+  if (sign)
+    body = h_sequence__m(mm__, h_optional__m(mm__, h_in__m(mm__, (const uint8_t*)"+-", 2)), body, NULL);
+  num->grammar = h_action__m(mm__, h_attr_bool__m(mm__, body, number_fits, num), act_number, num);
+  return h_new_parser(mm__, &number_vt, num);
+}
+
+HParser* h_decimal_uint(void) {
+  return number__m(&system_allocator, 10, false);
+}
+HParser* h_decimal_uint__m(HAllocator* mm__) {
+  return number__m(mm__, 10, false);
+}
+
+HParser* h_decimal_int(void) {
+  return number__m(&system_allocator, 10, true);
+}
+HParser* h_decimal_int__m(HAllocator* mm__) {
+  return number__m(mm__, 10, true);
+}
+
+HParser* h_hex_uint(void) {
+  return number__m(&system_allocator, 16, false);
+}
+HParser* h_hex_uint__m(HAllocator* mm__) {
+  return number__m(mm__, 16, false);
+}
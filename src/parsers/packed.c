@@ -0,0 +1,73 @@
+#include "parser_internal.h"
+
+typedef struct {
+  const struct bits_env *elem;
+  size_t n;
+  bool exact;   // h_packed_repeat_n: exactly n, else as many as there are
+} HPacked;
+
+static HParseResult* parse_packed(void *env, HParseState *state) {
+  HPacked *pk = (HPacked*)env;
+  HInputStream *in = &state->input_stream;
+  size_t width = pk->elem->length / 8;
+
+  // in the middle of a byte, the last integer extends into one more
+  size_t avail = in->length - in->index;
+  if (!h_input_aligned(in))
+    avail = avail > 0 ? avail - 1 : 0;
+  size_t n = avail / width;
+  if (pk->exact) {
+    if (n < pk->n)
+      return NULL;
+    n = pk->n;
+  }
+
+  HPackedArray *arr = a_new(HPackedArray, 1);
+  arr->len = n;
+  arr->width = width;
+  arr->signedp = pk->elem->signedp;
+  // the arena does not align, so leave room to align the elements
+  uintptr_t raw = (uintptr_t)h_arena_malloc(state->arena, n * width + width - 1);
+  arr->elements = (void*)((raw + width - 1) & ~(uintptr_t)(width - 1));
+
+  HParsedToken *tok = a_new(HParsedToken, 1);
+  tok->token_type = TT_USER;
+  tok->user = arr;
+  tok->index = in->index;
+  tok->bit_offset = in->bit_offset;
+  h_read_packed(in, arr->elements, n, width);
+  return make_result(state->arena, tok);
+}
+
+static const HParserVtable packed_vt = {
+  .parse = parse_packed,
+  .isValidRegular = h_false,
+  .isValidCF = h_false,
+};
+
+static HParser* packed__m(HAllocator* mm__, const HParser* p, size_t n, bool exact) {
+  if (!p || p->vtable != &h__bits_vt)
+    return NULL;
+  const struct bits_env *elem = p->env;
+  if (elem->length != 8 && elem->length != 16 && elem->length != 32 && elem->length != 64)
+    return NULL;
+  HPacked *env = h_new(HPacked, 1);
+  env->elem = elem;
+  env->n = n;
+  env->exact = exact;
+  return h_new_parser(mm__, &packed_vt, env);
+}
+
+HParser* h_packed_many(const HParser* p) {
+  return packed__m(&system_allocator, p, 0, false);
+}
+HParser* h_packed_many__m(HAllocator* mm__, const HParser* p) {
+  return packed__m(mm__, p, 0, false);
+}
+
+HParser* h_packed_repeat_n(const HParser* p, const size_t n) {
+  return packed__m(&system_allocator, p, n, true);
+}
+HParser* h_packed_repeat_n__m(HAllocator* mm__, const HParser* p, const size_t n) {
+  return packed__m(mm__, p, n, true);
+}
@@ -21,6 +21,20 @@ static inline HParseResult* make_result(HArena *arena, HParsedToken *tok) {
   return ret;
 }
 
+// the charset parsers (h_ch_range, h_in, h_not_in), whose env is the HCharset
+extern const HParserVtable h__charset_vt;
+
+// if p is h_many or h_many1 of a charset, the set to scan its run with and
+// the least length of the run in *min; otherwise NULL
+const HSpanSet *h_many_span(const HParser *p, size_t *min);
+
+// h_bits and the fixed-width integers built on it
+struct bits_env {
+  uint8_t length;
+  uint8_t signedp;
+};
+extern const HParserVtable h__bits_vt;
+
 // return token size in bits...
 static inline size_t token_length(HParseResult *pr) {
   if (pr) {
@@ -0,0 +1,78 @@
+#include "parser_internal.h"
+
+typedef struct {
+  const HParser *p;
+  unsigned int level;
+  enum HCFAssoc assoc;
+} HPrec;
+
+static HParseResult* parse_prec(void *env, HParseState *state) {
+  HPrec *a = (HPrec*)env;
+  return h_do_parse(a->p, state);
+}
+
+static bool prec_isValidRegular(void *env) {
+  HPrec *a = (HPrec*)env;
+  return a->p->vtable->isValidRegular(a->p->env);
+}
+
+static bool prec_isValidCF(void *env) {
+  HPrec *a = (HPrec*)env;
+  return a->p->vtable->isValidCF(a->p->env);
+}
+
+static void desugar_prec(HAllocator *mm__, HCFStack *stk__, void *env) {
+  HPrec *a = (HPrec*)env;
+
+  HCFS_BEGIN_CHOICE() {
+    HCFS_BEGIN_SEQ() {
+      HCFS_DESUGAR(a->p);
+    } HCFS_END_SEQ();
+    HCFS_THIS_CHOICE->reshape = h_act_first;
+    HCFS_THIS_CHOICE->prec = a->level;
+    HCFS_THIS_CHOICE->assoc = a->assoc;
+  } HCFS_END_CHOICE();
+}
+
+static bool prec_ctrvm(HRVMProg *prog, void *env) {
+  HPrec *a = (HPrec*)env;
+  return h_compile_regex(prog, a->p);
+}
+
+static const HParserVtable prec_vt = {
+  .parse = parse_prec,
+  .isValidRegular = prec_isValidRegular,
+  .isValidCF = prec_isValidCF,
+  .desugar = desugar_prec,
+  .compile_to_rvm = prec_ctrvm,
+};
+
+static HParser* prec__m(HAllocator* mm__, const HParser* p, unsigned int level,
+                        enum HCFAssoc assoc) {
+  HPrec *env = h_new(HPrec, 1);
+  env->p = p;
+  env->level = level;
+  env->assoc = assoc;
+  return h_new_parser(mm__, &prec_vt, env);
+}
+
+HParser* h_left_assoc(const HParser* p, unsigned int level) {
+  return h_left_assoc__m(&system_allocator, p, level);
+}
+HParser* h_left_assoc__m(HAllocator* mm__, const HParser* p, unsigned int level) {
+  return prec__m(mm__, p, level, HCF_LEFT_ASSOC);
+}
+
+HParser* h_right_assoc(const HParser* p, unsigned int level) {
+  return h_right_assoc__m(&system_allocator, p, level);
+}
+HParser* h_right_assoc__m(HAllocator* mm__, const HParser* p, unsigned int level) {
+  return prec__m(mm__, p, level, HCF_RIGHT_ASSOC);
+}
+
+HParser* h_nonassoc(const HParser* p, unsigned int level) {
+  return h_nonassoc__m(&system_allocator, p, level);
+}
+HParser* h_nonassoc__m(HAllocator* mm__, const HParser* p, unsigned int level) {
+  return prec__m(mm__, p, level, HCF_NONASSOC);
+}
@@ -2,15 +2,96 @@
 #include <assert.h>
 #include "parser_internal.h"
 
+// a run of fixed-width fields (h_bits) starting at some element
+typedef struct {
+  size_t n;      // fields in the run, or 0 if fewer than two
+  size_t bits;   // their total width
+} HFieldRun;
+
 typedef struct {
   size_t len;
   HParser **p_array;
+  HFieldRun *runs;
 } HSequence;
 
+static bool is_field(const HParser *p) {
+  if (!p || p->vtable != &h__bits_vt)
+    return false;
+  const struct bits_env *f = p->env;
+  return f->length > 0 && f->length <= 64;
+}
+
+// find the runs that parse_fields can decode in one go
+static void find_field_runs(HAllocator *mm__, HSequence *s) {
+  s->runs = h_new(HFieldRun, s->len);
+  size_t n = 0, bits = 0;
+  for (size_t i = s->len; i-- > 0; ) {
+    if (is_field(s->p_array[i])) {
+      n++;
+      bits += ((const struct bits_env*)s->p_array[i]->env)->length;
+    } else
+      n = bits = 0;
+    s->runs[i].n = n >= 2 ? n : 0;
+    s->runs[i].bits = bits;
+  }
+}
+
+// decode a run of big-endian fields with a single bounds check, shifting
+// and masking them out of 64-bit words loaded as the run goes along
+static bool parse_fields(HParser **fields, const HFieldRun *run,
+                         HParseState *state, HCountedArray *seq) {
+  HInputStream *in = &state->input_stream;
+  size_t pos = in->index * 8 + (8 - in->bit_offset);
+  if (in->length * 8 - pos < run->bits)
+    return false;
+
+  HParsedToken *toks = a_new(HParsedToken, run->n);
+  uint64_t w = 0;
+  size_t wpos = 0;              // bit position of w in the input
+  bool loaded = false;
+  for (size_t i = 0; i < run->n; i++) {
+    const struct bits_env *f = fields[i]->env;
+    size_t len = f->length;
+    if (!loaded || pos + len > wpos + 64) {
+      wpos = pos & ~(size_t)7;
+      loaded = (wpos / 8 + 8 <= in->length);
+      if (loaded)
+        w = h_load_be64(in->input + wpos / 8);
+    }
+    HParsedToken *tok = &toks[i];
+    if (loaded && pos + len <= wpos + 64) {
+      uint64_t x = w << (pos - wpos);
+      tok->uint = f->signedp ? (uint64_t)((int64_t)x >> (64 - len)) : x >> (64 - len);
+    } else {
+      // too close to the end to load a word, or wider than what is left of it
+      HInputStream tmp = *in;
+      tmp.index = pos / 8;
+      tmp.bit_offset = 8 - pos % 8;
+      tok->uint = h_read_bits(&tmp, len, f->signedp);
+    }
+    tok->token_type = f->signedp ? TT_SINT : TT_UINT;
+    tok->index = pos / 8;
+    tok->bit_offset = 8 - pos % 8;
+    h_carray_append(seq, tok);
+    pos += len;
+  }
+  in->index = pos / 8;
+  in->bit_offset = 8 - pos % 8;
+  return true;
+}
+
 static HParseResult* parse_sequence(void *env, HParseState *state) {
   HSequence *s = (HSequence*)env;
   HCountedArray *seq = h_carray_new_sized(state->arena, (s->len > 0) ? s->len : 4);
+  bool big_endian = (state->input_stream.endianness & BIT_BIG_ENDIAN)
+                 && (state->input_stream.endianness & BYTE_BIG_ENDIAN);
   for (size_t i=0; i<s->len; ++i) {
+    if (big_endian && s->runs[i].n > 0) {
+      if (!parse_fields(s->p_array + i, &s->runs[i], state, seq))
+        return NULL;
+      i += s->runs[i].n - 1;
+      continue;
+    }
     HParseResult *tmp = h_do_parse(s->p_array[i], state);
     // if the interim parse fails, the whole thing fails
     if (NULL == tmp) {
@@ -136,6 +217,7 @@ HParser* h_sequence__mv(HAllocator* mm__, HParser *p, va_list ap_) {
   va_end(ap);
 
   s->len = len;
+  find_field_runs(mm__, s);
   return h_new_parser(mm__, &sequence_vt, s);
 }
 
@@ -159,9 +241,6 @@ HParser* h_sequence__ma(HAllocator* mm__, void *args[]) {
   }
 
   s->len = len;
-  HParser *ret = h_new(HParser, 1);
-  ret->vtable = &sequence_vt; 
-  ret->env = (void*)s; 
-  ret->backend = PB_MIN;
-  return ret;
+  find_field_runs(mm__, s);
+  return h_new_parser(mm__, &sequence_vt, s);
 }
@@ -1,4 +1,5 @@
 #include <assert.h>
+#include <string.h>
 #include "parser_internal.h"
 
 typedef struct {
@@ -8,10 +9,17 @@ typedef struct {
 
 static HParseResult* parse_token(void *env, HParseState *state) {
   HToken *t = (HToken*)env;
-  for (int i=0; i<t->len; ++i) {
-    uint8_t chr = (uint8_t)h_read_bits(&state->input_stream, 8, false);
-    if (t->str[i] != chr) {
+  HInputStream *in = &state->input_stream;
+  if (h_input_aligned(in) && in->length - in->index >= t->len) {
+    if (memcmp(in->input + in->index, t->str, t->len) != 0)
       return NULL;
+    in->index += t->len;
+  } else {
+    for (int i=0; i<t->len; ++i) {
+      uint8_t chr = (uint8_t)h_read_bits(in, 8, false);
+      if (t->str[i] != chr) {
+        return NULL;
+      }
     }
   }
   HParsedToken *tok = a_new(HParsedToken, 1);
@@ -67,7 +75,7 @@ static bool token_ctrvm(HRVMProg *prog, void *env) {
   return true;
 }
 
-const HParserVtable token_vt = {
+static const HParserVtable token_vt = {
   .parse = parse_token,
   .isValidRegular = h_true,
   .isValidCF = h_true,
@@ -0,0 +1,208 @@
+#include <assert.h>
+#include <string.h>
+#include "parser_internal.h"
+
+/* The words as a trie, stored as a table: node s goes to node
+ * next[s * nclasses + bclass[c]] on byte c, or nowhere if that is 0. Bytes
+ * in no word are class 0; with nocase, the two cases of a letter are one
+ * class. Node 0 is the root.
+ */
+typedef struct {
+  uint16_t bclass[256];
+  size_t nclasses;
+  size_t nnodes;
+  uint32_t *next;
+  HBytes **ends;        // the word ending at each node, or NULL
+  HParser *grammar;     // the same trie, as parsers for the other backends
+} HTokenSet;
+
+static inline uint32_t trie_step(const HTokenSet *ts, uint32_t s, uint8_t c) {
+  return ts->next[s * ts->nclasses + ts->bclass[c]];
+}
+
+// the longest word at the start of the input
+static HParseResult* parse_token_set(void *env, HParseState *state) {
+  HTokenSet *ts = (HTokenSet*)env;
+  HInputStream *in = &state->input_stream;
+  const HBytes *word = ts->ends[0];
+  HInputStream end = *in;
+  if (h_input_aligned(in)) {
+    const uint8_t *p = in->input + in->index;
+    size_t avail = in->length - in->index, len = 0;
+    uint32_t s = 0;
+    for (size_t i = 0; i < avail && (s = trie_step(ts, s, p[i])) != 0; i++) {
+      if (ts->ends[s]) {
+        word = ts->ends[s];
+        len = i + 1;
+      }
+    }
+    end.index += len;
+  } else {
+    HInputStream after, cur = *in;
+    uint32_t s = 0;
+    for (int c; (c = h_next_byte(&cur, &after)) >= 0 && (s = trie_step(ts, s, c)) != 0; ) {
+      cur = after;
+      if (ts->ends[s]) {
+        word = ts->ends[s];
+        end = cur;
+      }
+    }
+  }
+  if (!word)
+    return NULL;
+
+  HParsedToken *tok = a_new(HParsedToken, 1);
+  tok->token_type = TT_BYTES;
+  tok->bytes = *word;
+  tok->index = in->index;
+  tok->bit_offset = in->bit_offset;
+  *in = end;
+  return make_result(state->arena, tok);
+}
+
+// the word the grammar matched, spelled as it was given
+static HParsedToken* act_token_set(const HParseResult *p, void *env) {
+  HTokenSet *ts = (HTokenSet*)env;
+  uint32_t s = 0;
+  for (size_t i = 0; i < p->ast->bytes.len; i++)
+    s = trie_step(ts, s, p->ast->bytes.token[i]);
+  assert(ts->ends[s]);
+  HParsedToken *tok = a_new_(p->arena, HParsedToken, 1);
+  tok->token_type = TT_BYTES;
+  tok->bytes = *ts->ends[s];
+  tok->index = p->ast->index;
+  tok->bit_offset = p->ast->bit_offset;
+  return tok;
+}
+
+static bool token_set_isValidRegular(void *env) {
+  HTokenSet *ts = (HTokenSet*)env;
+  return ts->grammar->vtable->isValidRegular(ts->grammar->env);
+}
+
+static bool token_set_isValidCF(void *env) {
+  HTokenSet *ts = (HTokenSet*)env;
+  return ts->grammar->vtable->isValidCF(ts->grammar->env);
+}
+
+static void desugar_token_set(HAllocator *mm__, HCFStack *stk__, void *env) {
+  HTokenSet *ts = (HTokenSet*)env;
+  HCFS_DESUGAR(ts->grammar);
+}
+
+static bool token_set_ctrvm(HRVMProg *prog, void *env) {
+  HTokenSet *ts = (HTokenSet*)env;
+  return h_compile_regex(prog, ts->grammar);
+}
+
+static const HParserVtable token_set_vt = {
+  .parse = parse_token_set,
+  .isValidRegular = token_set_isValidRegular,
+  .isValidCF = token_set_isValidCF,
+  .desugar = desugar_token_set,
+  .compile_to_rvm = token_set_ctrvm,
+};
+
+// node s of the trie and all below it: a choice of one edge per class, each
+// followed by the node it leads to, and of the end of a word
+static HParser* trie_grammar(HAllocator *mm__, const HTokenSet *ts, uint32_t s) {
+  HParser **alts = h_new(HParser*, ts->nclasses + 1);
+  size_t nalts = 0;
+  for (size_t c = 1; c < ts->nclasses; c++) {
+    uint32_t t = ts->next[s * ts->nclasses + c];
+    if (!t)
+      continue;
+    uint8_t members[2];
+    size_t nmembers = 0;
+    for (int b = 0; b < 256; b++)
+      if (ts->bclass[b] == c)
+        members[nmembers++] = b;
+    HParser *edge = (nmembers == 1)
+      ? h_ch__m(mm__, members[0])
+      : h_in__m(mm__, members, nmembers);
+    alts[nalts++] = h_sequence__m(mm__, edge, trie_grammar(mm__, ts, t), NULL);
+  }
+  if (ts->ends[s])
+    alts[nalts++] = h_epsilon_p__m(mm__);
+  alts[nalts] = NULL;
+
+  HParser *ret;
+  if (nalts == 0)
+    ret = h_nothing_p__m(mm__);
+  else if (nalts == 1)
+    ret = alts[0];
+  else
+    ret = h_choice__ma(mm__, (void**)alts);
+  mm__->free(mm__, alts);
+  return ret;
+}
+
+static uint8_t fold_case(uint8_t c) {
+  return (c >= 'A' && c <= 'Z') ? c - 'A' + 'a' : c;
+}
+
+static HParser* token_set__m(HAllocator* mm__, const char **words, size_t n, bool nocase) {
+  HTokenSet *ts = h_new(HTokenSet, 1);
+  memset(ts->bclass, 0, sizeof(ts->bclass));
+  ts->nclasses = 1;
+  size_t total = 0;
+  for (size_t i = 0; i < n; i++) {
+    size_t len = strlen(words[i]);
+    total += len;
+    for (size_t j = 0; j < len; j++) {
+      uint8_t c = words[i][j];
+      if (nocase)
+        c = fold_case(c);
+      if (ts->bclass[c] == 0) {
+        ts->bclass[c] = ts->nclasses++;
+        if (nocase && c >= 'a' && c <= 'z')
+          ts->bclass[c - 'a' + 'A'] = ts->bclass[c];
+      }
+    }
+  }
+
+  // at most a node per byte of the words, and the root
+  size_t cap = total + 1;
+  ts->next = h_new(uint32_t, cap * ts->nclasses);
+  memset(ts->next, 0, cap * ts->nclasses * sizeof(uint32_t));
+  ts->ends = h_new(HBytes*, cap);
+  memset(ts->ends, 0, cap * sizeof(HBytes*));
+  ts->nnodes = 1;
+  for (size_t i = 0; i < n; i++) {
+    size_t len = strlen(words[i]);
+    uint32_t s = 0;
+    for (size_t j = 0; j < len; j++) {
+      uint32_t *t = &ts->next[s * ts->nclasses + ts->bclass[(uint8_t)words[i][j]]];
+      if (!*t)
+        *t = ts->nnodes++;
+      s = *t;
+    }
+    if (ts->ends[s])
+      continue;         // the first of equal words wins
+    HBytes *word = h_new(HBytes, 1);
+    uint8_t *str = h_new(uint8_t, len);
+    memcpy(str, words[i], len);
+    word->token = str;
+    word->len = len;
+    ts->ends[s] = word;
+  }
+  ts->next = mm__->realloc(mm__, ts->next, ts->nnodes * ts->nclasses * sizeof(uint32_t));
+  ts->ends = mm__->realloc(mm__, ts->ends, ts->nnodes * sizeof(HBytes*));
+
+  ts->grammar = h_action__m(mm__, h_capture__m(mm__, trie_grammar(mm__, ts, 0)), act_token_set, ts);
+  return h_new_parser(mm__, &token_set_vt, ts);
+}
+
+HParser* h_token_set(const char **words, size_t n) {
+  return token_set__m(&system_allocator, words, n, false);
+}
+HParser* h_token_set__m(HAllocator* mm__, const char **words, size_t n) {
+  return token_set__m(mm__, words, n, false);
+}
+
+HParser* h_token_set_nocase(const char **words, size_t n) {
+  return token_set__m(&system_allocator, words, n, true);
+}
+HParser* h_token_set_nocase__m(HAllocator* mm__, const char **words, size_t n) {
+  return token_set__m(mm__, words, n, true);
+}
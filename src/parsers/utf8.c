@@ -0,0 +1,106 @@
+#include <assert.h>
+#include "parser_internal.h"
+
+static HParseResult* parse_utf8_span(void *env, HParseState *state) {
+  HInputStream *in = &state->input_stream;
+  if (!h_input_aligned(in))
+    return NULL;
+  HParsedToken *tok = a_new(HParsedToken, 1);
+  tok->token_type = TT_BYTES;
+  tok->index = in->index;
+  tok->bit_offset = in->bit_offset;
+  tok->bytes.token = in->input + in->index;
+  tok->bytes.len = h_read_utf8(in);
+  return make_result(state->arena, tok);
+}
+
+static bool utf8_span_isValidRegular(void *env) {
+  HParser *grammar = (HParser*)env;
+  return grammar->vtable->isValidRegular(grammar->env);
+}
+
+static bool utf8_span_isValidCF(void *env) {
+  HParser *grammar = (HParser*)env;
+  return grammar->vtable->isValidCF(grammar->env);
+}
+
+static void desugar_utf8_span(HAllocator *mm__, HCFStack *stk__, void *env) {
+  HCFS_DESUGAR( (HParser*)env );
+}
+
+static bool utf8_span_ctrvm(HRVMProg *prog, void *env) {
+  return h_compile_regex(prog, (HParser*)env);
+}
+
+static const HParserVtable utf8_span_vt = {
+  .parse = parse_utf8_span,
+  .isValidRegular = utf8_span_isValidRegular,
+  .isValidCF = utf8_span_isValidCF,
+  .desugar = desugar_utf8_span,
+  .compile_to_rvm = utf8_span_ctrvm,
+};
+
+// one well-formed character, after table 3-7 of the Unicode standard
+static HParser* utf8_char__m(HAllocator* mm__) {
+  HParser *cont = h_ch_range__m(mm__, 0x80, 0xBF);
+  return h_choice__m(mm__,
+    h_ch_range__m(mm__, 0x00, 0x7F),
+    h_sequence__m(mm__, h_ch_range__m(mm__, 0xC2, 0xDF), cont, NULL),
+    h_sequence__m(mm__, h_ch__m(mm__, 0xE0), h_ch_range__m(mm__, 0xA0, 0xBF), cont, NULL),
+    h_sequence__m(mm__, h_ch_range__m(mm__, 0xE1, 0xEC), cont, cont, NULL),
+    h_sequence__m(mm__, h_ch__m(mm__, 0xED), h_ch_range__m(mm__, 0x80, 0x9F), cont, NULL),
+    h_sequence__m(mm__, h_ch_range__m(mm__, 0xEE, 0xEF), cont, cont, NULL),
+    h_sequence__m(mm__, h_ch__m(mm__, 0xF0), h_ch_range__m(mm__, 0x90, 0xBF), cont, cont, NULL),
+    h_sequence__m(mm__, h_ch_range__m(mm__, 0xF1, 0xF3), cont, cont, cont, NULL),
+    h_sequence__m(mm__, h_ch__m(mm__, 0xF4), h_ch_range__m(mm__, 0x80, 0x8F), cont, cont, NULL),
+    NULL);
+}
+
+HParser* h_utf8_span(void) {
+  return h_utf8_span__m(&system_allocator);
+}
+HParser* h_utf8_span__m(HAllocator* mm__) {
+  // the other backends take the same language a character at a time
+  HParser *grammar = h_capture__m(mm__, h_many__m(mm__, utf8_char__m(mm__)));
+  return h_new_parser(mm__, &utf8_span_vt, grammar);
+}
+
+
+static HParseResult* parse_utf8(void *env, HParseState *state) {
+  HInputStream *in = &state->input_stream;
+  if (!h_input_aligned(in))
+    return NULL;
+  size_t start = in->index;
+  if (!h_do_parse((HParser*)env, state) || !h_input_aligned(in))
+    return NULL;
+
+  // all of what p consumed must be characters
+  HInputStream span = *in;
+  span.index = start;
+  span.length = in->index;
+  if (h_read_utf8(&span) != in->index - start)
+    return NULL;
+
+  HParsedToken *tok = a_new(HParsedToken, 1);
+  tok->token_type = TT_BYTES;
+  tok->bytes.token = in->input + start;
+  tok->bytes.len = in->index - start;
+  tok->index = start;
+  tok->bit_offset = in->bit_offset;
+  return make_result(state->arena, tok);
+}
+
+// the language of p intersected with that of UTF-8 text is not one the
+// regex VM or the CFG backends can build from p's
+static const HParserVtable utf8_vt = {
+  .parse = parse_utf8,
+  .isValidRegular = h_false,
+  .isValidCF = h_false,
+};
+
+HParser* h_utf8(const HParser* p) {
+  return h_utf8__m(&system_allocator, p);
+}
+HParser* h_utf8__m(HAllocator* mm__, const HParser* p) {
+  return h_new_parser(mm__, &utf8_vt, (void *)p);
+}
@@ -0,0 +1,163 @@
+#include <assert.h>
+#include "parser_internal.h"
+
+typedef struct {
+  bool zigzag;          // h_varint_s64
+  HParser *grammar;     // the same language, spelled out for the other backends
+} HVarint;
+
+#define VARINT_MAX 10   // bytes in the longest 64-bit varint
+
+// gather the low 7 bits of each byte of x, first byte lowest
+static inline uint64_t varint_compact(uint64_t x) {
+  x &= 0x7F7F7F7F7F7F7F7FULL;
+  x = ((x & 0x7F007F007F007F00ULL) >> 1) | (x & 0x007F007F007F007FULL);
+  x = ((x & 0x3FFF00003FFF0000ULL) >> 2) | (x & 0x00003FFF00003FFFULL);
+  return ((x & 0x0FFFFFFF00000000ULL) >> 4) | (x & 0x000000000FFFFFFFULL);
+}
+
+// fold in the n-th byte (from 0) of a varint; false if the value overflows
+static inline bool varint_add_byte(uint64_t *v, size_t n, uint8_t b) {
+  if (n == VARINT_MAX - 1 && b > 1)
+    return false;
+  *v |= (uint64_t)(b & 0x7F) << (7 * n);
+  return true;
+}
+
+// read a varint; false if the input ends first or it is too long
+static bool read_varint(HInputStream *in, uint64_t *value) {
+  uint64_t v = 0;
+  size_t n = 0;
+  if (h_input_aligned(in) && in->length - in->index >= 8) {
+    const uint8_t *p = in->input + in->index;
+    uint64_t w = h_load_le64(p);
+    uint64_t stop = ~w & 0x8080808080808080ULL;
+    if (stop) {
+      // clear the bytes past the last one
+      int bits = __builtin_ctzll(stop) + 1;
+      if (bits < 64)
+        w &= (1ULL << bits) - 1;
+      *value = varint_compact(w);
+      in->index += bits / 8;
+      return true;
+    }
+    // 8 continuation bytes; the rest one at a time
+    v = varint_compact(w);
+    n = 8;
+    in->index += 8;
+  }
+  for (HInputStream after; n < VARINT_MAX; n++) {
+    int c = h_next_byte(in, &after);
+    if (c < 0 || !varint_add_byte(&v, n, c))
+      return false;
+    *in = after;
+    if (!(c & 0x80)) {
+      *value = v;
+      return true;
+    }
+  }
+  return false;
+}
+
+static void varint_token(const HVarint *vi, uint64_t v, HParsedToken *tok) {
+  if (vi->zigzag) {
+    tok->token_type = TT_SINT;
+    tok->sint = (int64_t)(v >> 1) ^ -(int64_t)(v & 1);
+  } else {
+    tok->token_type = TT_UINT;
+    tok->uint = v;
+  }
+}
+
+static HParseResult* parse_varint(void *env, HParseState *state) {
+  HInputStream *in = &state->input_stream;
+  HParsedToken *tok = a_new(HParsedToken, 1);
+  tok->index = in->index;
+  tok->bit_offset = in->bit_offset;
+  uint64_t v;
+  if (!read_varint(in, &v))
+    return NULL;
+  varint_token((HVarint*)env, v, tok);
+  return make_result(state->arena, tok);
+}
+
+// fold what the grammar parsed, (continuation bytes, last byte); false if
+// the varint is too long
+static bool fold_varint(const HParsedToken *ast, uint64_t *value) {
+  const HCountedArray *conts = ast->seq->elements[0]->seq;
+  if (conts->used >= VARINT_MAX)
+    return false;
+  uint64_t v = 0;
+  for (size_t i = 0; i < conts->used; i++)
+    varint_add_byte(&v, i, conts->elements[i]->uint);
+  if (!varint_add_byte(&v, conts->used, ast->seq->elements[1]->uint))
+    return false;
+  *value = v;
+  return true;
+}
+
+static bool varint_fits(HParseResult *p, void *env) {
+  uint64_t v;
+  return fold_varint(p->ast, &v);
+}
+
+static HParsedToken* act_varint(const HParseResult *p, void *env) {
+  HParsedToken *tok = a_new_(p->arena, HParsedToken, 1);
+  uint64_t v = 0;
+  fold_varint(p->ast, &v);
+  varint_token((HVarint*)env, v, tok);
+  tok->index = p->ast->index;
+  tok->bit_offset = p->ast->bit_offset;
+  return tok;
+}
+
+static bool varint_isValidRegular(void *env) {
+  HVarint *vi = (HVarint*)env;
+  return vi->grammar->vtable->isValidRegular(vi->grammar->env);
+}
+
+static bool varint_isValidCF(void *env) {
+  HVarint *vi = (HVarint*)env;
+  return vi->grammar->vtable->isValidCF(vi->grammar->env);
+}
+
+static void desugar_varint(HAllocator *mm__, HCFStack *stk__, void *env) {
+  HVarint *vi = (HVarint*)env;
+  HCFS_DESUGAR(vi->grammar);
+}
+
+static bool varint_ctrvm(HRVMProg *prog, void *env) {
+  HVarint *vi = (HVarint*)env;
+  return h_compile_regex(prog, vi->grammar);
+}
+
+static const HParserVtable varint_vt = {
+  .parse = parse_varint,
+  .isValidRegular = varint_isValidRegular,
+  .isValidCF = varint_isValidCF,
+  .desugar = desugar_varint,
+  .compile_to_rvm = varint_ctrvm,
+};
+
+static HParser* varint__m(HAllocator* mm__, bool zigzag) {
+  HVarint *vi = h_new(HVarint, 1);
+  vi->zigzag = zigzag;
+  HParser *body = h_sequence__m(mm__, h_many__m(mm__, h_ch_range__m(mm__, 0x80, 0xFF)),
+                                h_ch_range__m(mm__, 0x00, 0x7F), NULL);
+  vi->grammar = h_action__m(mm__, h_attr_bool__m(mm__, body, varint_fits, vi), act_varint, vi);
+  return h_new_parser(mm__, &varint_vt, vi);
+}
+
+HParser* h_varint_u64(void) {
+  return varint__m(&system_allocator, false);
+}
+HParser* h_varint_u64__m(HAllocator* mm__) {
+  return varint__m(mm__, false);
+}
+
+HParser* h_varint_s64(void) {
+  return varint__m(&system_allocator, true);
+}
+HParser* h_varint_s64__m(HAllocator* mm__) {
+  return varint__m(mm__, true);
+}
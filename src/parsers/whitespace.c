@@ -2,9 +2,22 @@
 #include <assert.h>
 #include "parser_internal.h"
 
+// the bytes isspace() accepts in the "C" locale: '\t' '\n' '\v' '\f' '\r' ' '
+static const HSpanSet ws_span = {
+  .cs = NULL,
+  .nranges = 2,
+  .lo = {'\t', ' '},
+  .hi = {'\r', ' '},
+};
+
 static HParseResult* parse_whitespace(void* env, HParseState *state) {
   char c;
   HInputStream bak;
+  HInputStream *in = &state->input_stream;
+  if (h_input_aligned(in)) {
+    h_read_span(in, &ws_span);
+    return h_do_parse((HParser*)env, state);
+  }
   do {
     bak = state->input_stream;
     c = h_read_bits(&state->input_stream, 8, false);
@@ -28,7 +28,8 @@ typedef struct Entry_ {
 static void *tt_registry = NULL;
 static Entry** tt_by_id = NULL;
 static int tt_by_id_sz = 0;
-#define TT_START TT_USER
+// TT_USER itself is left to tokens of no registered type, such as h_packed's
+#define TT_START (TT_USER + 1)
 static int tt_next = TT_START;
 
 /*
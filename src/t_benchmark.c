@@ -1,7 +1,26 @@
 #include <glib.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
 #include "hammer.h"
+#include "glue.h"
+#include "internal.h"
 #include "test_suite.h"
 
+// nanoseconds since start, on the clock h_benchmark uses
+static double elapsed_ns(const struct timespec *start) {
+  struct timespec end;
+  h_benchmark_clock_gettime(&end);
+  return (end.tv_sec - start->tv_sec) * 1e9 + (end.tv_nsec - start->tv_nsec);
+}
+
+// the cost of one task done two ways, and how many times faster the second is
+static void report_speedup(const char *task, const char *unit, const char *way0, double ns0,
+                           const char *way1, double ns1) {
+  fprintf(stderr, "%s: %.2f ns/%s %s, %.2f ns/%s %s (%.1fx)\n",
+          task, ns0, unit, way0, ns1, unit, way1, ns0 / ns1);
+}
+
 HParserTestcase testcases[] = {
   {(unsigned char*)"1,2,3", 5, "(u0x31 u0x32 u0x33)"},
   {(unsigned char*)"1,3,2", 5, "(u0x31 u0x33 u0x32)"},
@@ -17,6 +36,177 @@ static void test_benchmark_1() {
   h_benchmark_report(stderr, res);
 }
 
+// a larger grammar, to measure table generation: expressions over many levels
+// of left-associative binary operators, and some statements built from them.
+static HParser *benchmark_grammar(void) {
+  const char *ops = "|^&=<>+-*/%";
+  HParser *expr = h_indirect();
+  HParser *num = h_many1(h_ch_range('0', '9'));
+  HParser *id = h_many1(h_ch_range('A', 'Z'));
+  HParser *e = h_choice(num, id, h_sequence(h_ch('('), expr, h_ch(')'), NULL), NULL);
+  for (const char *op = ops + strlen(ops) - 1; op >= ops; op--) {
+    HParser *level = h_indirect();
+    h_bind_indirect(level, h_choice(h_sequence(level, h_ch(*op), e, NULL), e, NULL));
+    e = level;
+  }
+  h_bind_indirect(expr, e);
+
+  HParser *stmt = h_indirect();
+  HParser *block = h_sequence(h_ch('{'), h_sepBy(stmt, h_ch(';')), h_ch('}'), NULL);
+  h_bind_indirect(stmt, h_choice(h_sequence(h_token((const uint8_t*)"if", 2), expr,
+                                            h_token((const uint8_t*)"then", 4), stmt, NULL),
+                                 h_sequence(h_token((const uint8_t*)"while", 5), expr, h_token((const uint8_t*)"do", 2), stmt, NULL),
+                                 h_sequence(id, h_token((const uint8_t*)":=", 2), expr, NULL),
+                                 block,
+                                 NULL));
+  return stmt;
+}
+
+static void test_benchmark_compile() {
+  HParserTestcase none[] = {{ NULL, 0, NULL }};
+  HBenchmarkResults *res = h_benchmark(benchmark_grammar(), none);
+  h_benchmark_report(stderr, res);
+}
+
+// h_read_bits on its own, for various widths and all orders of bits and bytes
+static void test_benchmark_bitreader() {
+  static const char *orders[] = {"LSB first, LE", "MSB first, LE",
+                                 "LSB first, BE", "MSB first, BE"};
+  static const int widths[] = {1, 8, 13, 32, 64};
+  enum { LEN = 1 << 16, ROUNDS = 64 };
+  uint8_t *buf = malloc(LEN);
+  for (size_t i=0; i<LEN; i++)
+    buf[i] = i * 2654435761u >> 24;
+
+  for (int e=0; e<4; e++) {
+    char endianness = (e & 1 ? BIT_BIG_ENDIAN : 0) | (e & 2 ? BYTE_BIG_ENDIAN : 0);
+    for (size_t w=0; w<sizeof(widths)/sizeof(widths[0]); w++) {
+      struct timespec start;
+      uint64_t sum = 0;
+      size_t reads = 0;
+      h_benchmark_clock_gettime(&start);
+      for (int r=0; r<ROUNDS; r++) {
+        HInputStream is = {
+          .input = buf,
+          .length = LEN,
+          .bit_offset = (endianness & BIT_BIG_ENDIAN) ? 8 : 0,
+          .endianness = endianness
+        };
+        while (!is.overrun) {
+          sum += h_read_bits(&is, widths[w], false);
+          reads++;
+        }
+      }
+      double ns = elapsed_ns(&start);
+      fprintf(stderr, "%s, %2d bits: %.2f ns/read (%llx)\n", orders[e], widths[w],
+              (double)ns / reads, (unsigned long long)sum & 0xF);
+    }
+  }
+  free(buf);
+}
+
+// the primitive parsers on their own, called directly over a long input,
+// starting on a byte boundary and one bit off it. the latter takes the
+// general h_read_bits path.
+static void test_benchmark_primitives() {
+  enum { LEN = 1 << 16, ROUNDS = 16 };
+  struct { const char *name; HParser *p; size_t width; } prims[] = {
+    {"h_ch", h_ch('a'), 1},
+    {"h_ch_range", h_ch_range('a', 'z'), 1},
+    {"h_token", h_token((const uint8_t*)"aaaaaaaa", 8), 8},
+    {"h_uint8", h_uint8(), 1},
+    {"h_uint32", h_uint32(), 4},
+    {"h_int64", h_int64(), 8},
+  };
+  // buf holds LEN bytes 'a'; buf1 holds the same bytes
+  // starting at bit 1 (in MSB-first order).
+  uint8_t *buf = malloc(LEN + 1), *buf1 = malloc(LEN + 1);
+  for (size_t i=0; i<LEN; i++)
+    buf[i] = 'a';
+  buf[LEN] = 0;
+  for (size_t i=0; i<=LEN; i++)
+    buf1[i] = (i ? buf[i-1] << 7 : 0) | buf[i] >> 1;
+
+  for (size_t k=0; k<sizeof(prims)/sizeof(prims[0]); k++) {
+    double ns_per[2];
+    for (int shifted=0; shifted<2; shifted++) {
+      struct timespec start;
+      size_t parses = 0;
+      h_benchmark_clock_gettime(&start);
+      for (int r=0; r<ROUNDS; r++) {
+        HParseState state = {
+          .input_stream = {
+            .input = shifted ? buf1 : buf,
+            .length = LEN + shifted,
+            .bit_offset = shifted ? 7 : 8,
+            .endianness = BIT_BIG_ENDIAN | BYTE_BIG_ENDIAN
+          },
+          .arena = h_new_arena(&system_allocator, 0)
+        };
+        while (state.input_stream.index + prims[k].width <= LEN) {
+          if (!prims[k].p->vtable->parse(prims[k].p->env, &state))
+            break;
+          // start over often, so the results stay in cache
+          if (++parses % 32 == 0) {
+            h_delete_arena(state.arena);
+            state.arena = h_new_arena(&system_allocator, 0);
+          }
+        }
+        g_check_cmp_uint64(state.input_stream.index + prims[k].width, >, LEN);
+        h_delete_arena(state.arena);
+      }
+      double ns = elapsed_ns(&start);
+      ns_per[shifted] = (double)ns / parses;
+    }
+    report_speedup(prims[k].name, "parse", "unaligned", ns_per[1], "aligned", ns_per[0]);
+  }
+  free(buf);
+  free(buf1);
+}
+
+// h_read_span over a long identifier, tested by ranges (16 or 32 bytes at a
+// time) and by the bitmap alone (a byte at a time)
+static void test_benchmark_span() {
+  enum { LEN = 1 << 16, ROUNDS = 64 };
+  uint8_t *buf = malloc(LEN);
+  for (size_t i=0; i<LEN; i++)
+    buf[i] = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789_"[i % 63];
+  HCharset ident = new_charset(&system_allocator);
+  for (int c=0; c<256; c++)
+    charset_set(ident, c, memchr(buf, c, 63) != NULL);
+  HSpanSet ranges, bitmap;
+  h_span_set_init(&ranges, ident);
+  bitmap = ranges;
+  bitmap.nranges = 0;
+
+  const HSpanSet *sets[2] = {&ranges, &bitmap};
+  for (int s=0; s<2; s++) {
+    struct timespec start;
+    h_benchmark_clock_gettime(&start);
+    for (int r=0; r<ROUNDS; r++) {
+      HInputStream is = {
+        .input = buf,
+        .length = LEN,
+        .bit_offset = 8,
+        .endianness = BIT_BIG_ENDIAN | BYTE_BIG_ENDIAN
+      };
+      g_check_cmp_uint64(h_read_span(&is, sets[s]), ==, LEN);
+    }
+    double ns = elapsed_ns(&start);
+    fprintf(stderr, "span by %s: %.3f ns/byte\n", s ? "bitmap" : "ranges",
+            (double)ns / ((double)LEN * ROUNDS));
+  }
+  system_allocator.free(&system_allocator, ident);
+  free(buf);
+}
+
 void register_benchmark_tests(void) {
   g_test_add_func("/core/benchmark/1", test_benchmark_1);
+  // the timings take a while and check nothing; run them with -m perf
+  if (!g_test_perf())
+    return;
+  g_test_add_func("/core/benchmark/compile", test_benchmark_compile);
+  g_test_add_func("/core/benchmark/bitreader", test_benchmark_bitreader);
+  g_test_add_func("/core/benchmark/primitives", test_benchmark_primitives);
+  g_test_add_func("/core/benchmark/span", test_benchmark_span);
 }
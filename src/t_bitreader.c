@@ -1,4 +1,5 @@
 #include <stdint.h>
+#include <string.h>
 #include <glib.h>
 #include "hammer.h"
 #include "internal.h"
@@ -56,6 +57,144 @@ static void test_offset_largebits_le(void) {
   g_check_cmp_int32(h_read_bits(&is, 11, false), ==, 0x2D3);
 }
 
+// reads of whole words, in all four orders of bits and bytes
+static void test_bitreader_words(void) {
+  const char *buf = "\x01\x23\x45\x67\x89\xAB\xCD\xEF\xFE\xDC\xBA\x98\x76\x54\x32\x10";
+  HInputStream ll = MK_INPUT_STREAM(buf, 16, BIT_LITTLE_ENDIAN | BYTE_LITTLE_ENDIAN);
+  g_check_cmp_int64(h_read_bits(&ll, 3, false), ==, 0x1);
+  g_check_cmp_int64(h_read_bits(&ll, 40, false), ==, 0x712CE8A460);
+  g_check_cmp_int64(h_read_bits(&ll, 16, true), ==, -1611);
+  g_check_cmp_int64(h_read_bits(&ll, 8, false), ==, 0xDD);
+  HInputStream bl = MK_INPUT_STREAM(buf, 16, BIT_BIG_ENDIAN | BYTE_LITTLE_ENDIAN);
+  g_check_cmp_int64(h_read_bits(&bl, 3, false), ==, 0x0);
+  g_check_cmp_int64(h_read_bits(&bl, 40, false), ==, 0xB12CE8A461);
+  g_check_cmp_int64(h_read_bits(&bl, 16, true), ==, -1621);
+  g_check_cmp_int64(h_read_bits(&bl, 8, false), ==, 0xEF);
+  HInputStream lb = MK_INPUT_STREAM(buf, 16, BIT_LITTLE_ENDIAN | BYTE_BIG_ENDIAN);
+  g_check_cmp_int64(h_read_bits(&lb, 3, false), ==, 0x1);
+  g_check_cmp_int64(h_read_bits(&lb, 40, false), ==, 0x11A2B3C4B);
+  g_check_cmp_int64(h_read_bits(&lb, 16, true), ==, -20881);
+  g_check_cmp_int64(h_read_bits(&lb, 8, false), ==, 0xEE);
+  HInputStream bb = MK_INPUT_STREAM(buf, 16, BIT_BIG_ENDIAN | BYTE_BIG_ENDIAN);
+  g_check_cmp_int64(h_read_bits(&bb, 3, false), ==, 0x0);
+  g_check_cmp_int64(h_read_bits(&bb, 40, false), ==, 0x91A2B3C4D);
+  g_check_cmp_int64(h_read_bits(&bb, 16, true), ==, 0x5E6F);
+  g_check_cmp_int64(h_read_bits(&bb, 8, false), ==, 0x7F);
+  g_check_cmp_int64(bb.index, ==, 8);
+}
+
+// runs of every length up to 80, so that the vector loops end at every point
+// of a block, over sets given as ranges, as a bitmap only and with both.
+static void test_bitreader_span(void) {
+  HCharset ident = new_charset(&system_allocator);
+  HCharset sparse = new_charset(&system_allocator);
+  for (int c = 0; c < 256; c++) {
+    charset_set(ident, c, c == '_' || (c >= '0' && c <= '9')
+                          || (c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z'));
+    charset_set(sparse, c, c >= 'a' && c <= 'z' && c % 2 == 1);
+  }
+  HSpanSet sets[3];
+  h_span_set_init(&sets[0], ident);
+  h_span_set_init(&sets[1], sparse);
+  sets[2] = sets[0];
+  sets[2].cs = NULL;
+  g_check_cmp_int32(sets[0].nranges, ==, 4);
+  g_check_cmp_int32(sets[1].nranges, ==, 0);
+
+  uint8_t buf[96];
+  for (int s = 0; s < 3; s++) {
+    for (size_t n = 0; n <= 80; n++) {
+      for (size_t i = 0; i < sizeof(buf); i++)
+        buf[i] = (i < n) ? "acegikmoqsuwy"[i % 13] : (i == n) ? '-' : 'a';
+      HInputStream is = MK_INPUT_STREAM(buf, sizeof(buf), BIT_BIG_ENDIAN | BYTE_BIG_ENDIAN);
+      g_check_cmp_uint64(h_read_span(&is, &sets[s]), ==, n);
+      g_check_cmp_uint64(is.index, ==, n);
+      // up to the end of input
+      HInputStream all = MK_INPUT_STREAM(buf, n, BIT_BIG_ENDIAN | BYTE_BIG_ENDIAN);
+      g_check_cmp_uint64(h_read_span(&all, &sets[s]), ==, n);
+    }
+  }
+}
+
+// every width and byte order, with counts that end the vector loops at every
+// point of a block, and one bit off a byte boundary
+static void test_bitreader_packed(void) {
+  uint8_t buf[8 * 40 + 1];
+  for (size_t i = 0; i < sizeof(buf); i++)
+    buf[i] = i * 73 + 11;
+  const int widths[] = {1, 2, 4, 8};
+  const int orders[] = {BIT_BIG_ENDIAN | BYTE_BIG_ENDIAN, BIT_BIG_ENDIAN | BYTE_LITTLE_ENDIAN,
+                        BIT_LITTLE_ENDIAN | BYTE_LITTLE_ENDIAN};
+  for (int w = 0; w < 4; w++) {
+    int width = widths[w];
+    for (int o = 0; o < 3; o++) {
+      for (int skip = 0; skip < 2; skip++) {
+        for (size_t n = 0; n <= 40; n++) {
+          HInputStream is = MK_INPUT_STREAM(buf, sizeof(buf), orders[o]);
+          HInputStream ref = is;
+          if (skip) {
+            h_read_bits(&is, 1, false);
+            h_read_bits(&ref, 1, false);
+          }
+          uint64_t out[40];
+          h_read_packed(&is, out, n, width);
+          for (size_t i = 0; i < n; i++) {
+            uint64_t x = 0;
+            switch (width) {
+            case 1: x = ((uint8_t*)out)[i]; break;
+            case 2: x = ((uint16_t*)out)[i]; break;
+            case 4: x = ((uint32_t*)out)[i]; break;
+            case 8: x = out[i]; break;
+            }
+            g_check_cmp_uint64(x, ==, (uint64_t)h_read_bits(&ref, width * 8, false));
+          }
+          g_check_cmp_uint64(is.index, ==, ref.index);
+          g_check_cmp_int32(is.bit_offset, ==, ref.bit_offset);
+        }
+      }
+    }
+  }
+}
+
+// valid text of every length up to 80 bytes, so that the vector loops end at
+// every point of a block, followed by each kind of error or by the end
+static void test_bitreader_utf8(void) {
+  static const char *chars[] = {
+    "a", "\xC3\xA9", "\xE2\x82\xAC", "\xF0\x9F\x98\x80", "b",
+    "\xED\x9F\xBF", "\xF4\x8F\xBF\xBF", "\xEE\x80\x80", "\xE0\xA0\x80", "\xDF\xBF"
+  };
+  static const char *bad[] = {
+    "",                 // the end of input
+    "\x80", "\xFF", "\xF5\x80\x80\x80", "\xC1\xBF",
+    "\xC3" "a", "\xE2\x82" "a", "\xF0\x9F\x98" "a",
+    "\xE0\x9F\xBF",     // overlong
+    "\xED\xA0\x80",     // surrogate
+    "\xF0\x8F\xBF\xBF", // overlong
+    "\xF4\x90\x80\x80", // above U+10FFFF
+  };
+  uint8_t buf[128];
+  for (size_t b = 0; b < sizeof(bad) / sizeof(bad[0]); b++) {
+    for (size_t k = 0; k < 80; k++) {
+      size_t n = 0;
+      for (size_t i = 0; i < k && n < 80; i++) {
+        size_t len = strlen(chars[(i * 7 + k) % 10]);
+        memcpy(buf + n, chars[(i * 7 + k) % 10], len);
+        n += len;
+      }
+      size_t len = n;
+      memcpy(buf + len, bad[b], strlen(bad[b]));
+      len += strlen(bad[b]);
+      if (b > 0) {
+        // more valid text after the error
+        memset(buf + len, 'a', sizeof(buf) - len);
+        len = sizeof(buf);
+      }
+      HInputStream is = MK_INPUT_STREAM(buf, len, BIT_BIG_ENDIAN | BYTE_BIG_ENDIAN);
+      g_check_cmp_uint64(h_read_utf8(&is), ==, n);
+      g_check_cmp_uint64(is.index, ==, n);
+    }
+  }
+}
 
 void register_bitreader_tests(void)  {
   g_test_add_func("/core/bitreader/be", test_bitreader_be);
@@ -65,4 +204,8 @@ void register_bitreader_tests(void)  {
   g_test_add_func("/core/bitreader/offset-largebits-be", test_offset_largebits_be);
   g_test_add_func("/core/bitreader/offset-largebits-le", test_offset_largebits_le);
   g_test_add_func("/core/bitreader/ints", test_bitreader_ints);
+  g_test_add_func("/core/bitreader/words", test_bitreader_words);
+  g_test_add_func("/core/bitreader/span", test_bitreader_span);
+  g_test_add_func("/core/bitreader/packed", test_bitreader_packed);
+  g_test_add_func("/core/bitreader/utf8", test_bitreader_utf8);
 }
@@ -37,7 +37,40 @@ static void test_example_1(void) {
   g_check_followset_present(1, g, c, "y");
 }
 
+static void test_byteclasses(void) {
+  HParser *p = h_choice(h_sequence(h_ch_range('a', 'z'), h_ch('x'), NULL),
+                        h_ch_range('0', '9'), NULL);
+  HCFGrammar *g = h_cfgrammar(&system_allocator, p);
+
+  g_check_cmp_uint32(g->bclass['x'], ==, 'x');
+  g_check_cmp_uint32(g->bclass['b'], ==, 'a');
+  g_check_cmp_uint32(g->bclass['y'], ==, 'a');
+  g_check_cmp_uint32(g->bclass['7'], ==, '0');
+  g_check_cmp_uint32(g->bclass['z'+1], ==, 0);
+  g_check_cmp_uint32(g->bclass[255], ==, 0);
+
+  g_check_firstset_present(1, g, p, "a");
+  g_check_firstset_present(1, g, p, "0");
+  g_check_firstset_absent(1, g, p, "b");
+}
+
+static void test_span_terminal(void) {
+  HParser *c = h_many(h_ch_range('a', 'z'));
+  HParser *p = h_sequence(c, h_ch(';'), NULL);
+  HCFGrammar *g = h_cfgrammar(&system_allocator, p);
+
+  // c -> [a-z] d | "" ; d -> [a-z] d | ""
+  const HCFChoice *c_ = h_desugar(&system_allocator, NULL, c);
+  const HCFChoice *t = c_->seq[0]->items[0];
+  const HCFChoice *d = c_->seq[0]->items[1];
+
+  g_check_cmp_uint64((uintptr_t)h_span_terminal(g, d), ==, (uintptr_t)t);
+  g_check_cmp_uint64((uintptr_t)h_span_terminal(g, c_), ==, 0);
+}
+
 void register_grammar_tests(void) {
   g_test_add_func("/core/grammar/end", test_end);
   g_test_add_func("/core/grammar/example_1", test_example_1);
+  g_test_add_func("/core/grammar/byteclasses", test_byteclasses);
+  g_test_add_func("/core/grammar/span_terminal", test_span_terminal);
 }
@@ -296,6 +296,19 @@ static void test_many(gconstpointer backend) {
   //  g_check_parse_match(many_, (HParserBackend)GPOINTER_TO_INT(backend), "daabbabadef", 11, "()");
 }
 
+static void test_many_charset(gconstpointer backend) {
+  const HParser *word_ = h_sequence(h_many(h_ch_range('a', 'z')), h_ch(';'), NULL);
+  const HParser *many1_ = h_many1(h_ch('a'));
+
+  g_check_parse_match(word_, (HParserBackend)GPOINTER_TO_INT(backend), ";", 1, "(() u0x3b)");
+  g_check_parse_match(word_, (HParserBackend)GPOINTER_TO_INT(backend), "a;", 2, "((u0x61) u0x3b)");
+  g_check_parse_match(word_, (HParserBackend)GPOINTER_TO_INT(backend), "hello;", 6, "((u0x68 u0x65 u0x6c u0x6c u0x6f) u0x3b)");
+  g_check_parse_failed(word_, (HParserBackend)GPOINTER_TO_INT(backend), "hello", 5);
+  g_check_parse_failed(word_, (HParserBackend)GPOINTER_TO_INT(backend), "hel1o;", 6);
+  g_check_parse_match(many1_, (HParserBackend)GPOINTER_TO_INT(backend), "a", 1, "(u0x61)");
+  g_check_parse_match(many1_, (HParserBackend)GPOINTER_TO_INT(backend), "aaa", 3, "(u0x61 u0x61 u0x61)");
+}
+
 static void test_many1(gconstpointer backend) {
   const HParser *many1_ = h_many1(h_choice(h_ch('a'), h_ch('b'), NULL));
 
@@ -335,6 +348,258 @@ static void test_ignore(gconstpointer backend) {
   g_check_parse_failed(ignore_, (HParserBackend)GPOINTER_TO_INT(backend), "ac", 2);
 }
 
+static void test_capture(gconstpointer backend) {
+  const HParser *word = h_capture(h_many1(h_ch_range('a', 'z')));
+  const HParser *capture_ = h_sequence(h_ch('<'), word, h_ch('>'),
+                                       h_capture(h_many(h_ch('x'))), NULL);
+
+  g_check_parse_match(capture_, (HParserBackend)GPOINTER_TO_INT(backend), "<abc>xx", 7, "(u0x3c <61.62.63> u0x3e <78.78>)");
+  g_check_parse_match(capture_, (HParserBackend)GPOINTER_TO_INT(backend), "<q>", 3, "(u0x3c <71> u0x3e <>)");
+  g_check_parse_failed(capture_, (HParserBackend)GPOINTER_TO_INT(backend), "<>", 2);
+  g_check_parse_match(capture_, (HParserBackend)GPOINTER_TO_INT(backend), "<abcdefghijklmnopqrstuvwxyzabcdefghijklmn>", 42,
+		      "(u0x3c <61.62.63.64.65.66.67.68.69.6a.6b.6c.6d.6e.6f.70.71.72.73.74.75.76.77.78.79.7a"
+		      ".61.62.63.64.65.66.67.68.69.6a.6b.6c.6d.6e> u0x3e <>)");
+}
+
+static void test_bytes(gconstpointer backend) {
+  const HParser *bytes_ = h_sequence(h_bytes(3), h_skip(2), h_ch('x'), NULL);
+
+  g_check_parse_match(bytes_, (HParserBackend)GPOINTER_TO_INT(backend), "abcdex", 6, "(<61.62.63> u0x78)");
+  g_check_parse_failed(bytes_, (HParserBackend)GPOINTER_TO_INT(backend), "abcdx", 5);
+}
+
+static void test_bytes_too_long(gconstpointer backend) {
+  // more bytes than the regex VM has instructions for
+  HParser *bytes_ = h_sequence(h_bytes(40000), h_ch('z'), NULL);
+  g_check_cmp_int32(h_compile(bytes_, (HParserBackend)GPOINTER_TO_INT(backend), NULL), !=, 0);
+}
+
+static void test_bytes_unaligned(gconstpointer backend) {
+  const HParser *bytes_ = h_sequence(h_bits(4, false), h_bytes(1), h_skip(1), h_bits(4, false), NULL);
+
+  g_check_parse_match(bytes_, (HParserBackend)GPOINTER_TO_INT(backend), "\x12\x34\x56", 3, "(u0x1 <23> u0x6)");
+  g_check_parse_failed(bytes_, (HParserBackend)GPOINTER_TO_INT(backend), "\x12\x34", 2);
+}
+
+static void test_number(gconstpointer backend) {
+  const HParser *dec_ = h_sequence(h_decimal_uint(), h_ch(';'), NULL);
+  const HParser *hex_ = h_sequence(h_hex_uint(), h_ch(';'), NULL);
+  const HParser *int_ = h_sequence(h_decimal_int(), h_ch(';'), NULL);
+
+  g_check_parse_match(dec_, (HParserBackend)GPOINTER_TO_INT(backend), "7;", 2, "(u0x7 u0x3b)");
+  g_check_parse_match(dec_, (HParserBackend)GPOINTER_TO_INT(backend), "12345678901234567890;", 21, "(u0xab54a98ceb1f0ad2 u0x3b)");
+  g_check_parse_match(dec_, (HParserBackend)GPOINTER_TO_INT(backend), "000000000000000000000042;", 25, "(u0x2a u0x3b)");
+  g_check_parse_match(dec_, (HParserBackend)GPOINTER_TO_INT(backend), "18446744073709551615;", 21, "(u0xffffffffffffffff u0x3b)");
+  g_check_parse_failed(dec_, (HParserBackend)GPOINTER_TO_INT(backend), "18446744073709551616;", 21);
+  g_check_parse_failed(dec_, (HParserBackend)GPOINTER_TO_INT(backend), ";", 1);
+
+  g_check_parse_match(hex_, (HParserBackend)GPOINTER_TO_INT(backend), "deadBEEF01234567;", 17, "(u0xdeadbeef01234567 u0x3b)");
+  g_check_parse_match(hex_, (HParserBackend)GPOINTER_TO_INT(backend), "0000000000000000FFffffffffffffff;", 33, "(u0xffffffffffffffff u0x3b)");
+  g_check_parse_match(hex_, (HParserBackend)GPOINTER_TO_INT(backend), "a0;", 3, "(u0xa0 u0x3b)");
+  g_check_parse_failed(hex_, (HParserBackend)GPOINTER_TO_INT(backend), "10000000000000000;", 18);
+  g_check_parse_failed(hex_, (HParserBackend)GPOINTER_TO_INT(backend), "g;", 2);
+
+  g_check_parse_match(int_, (HParserBackend)GPOINTER_TO_INT(backend), "-12;", 4, "(s-0xc u0x3b)");
+  g_check_parse_match(int_, (HParserBackend)GPOINTER_TO_INT(backend), "12;", 3, "(s0xc u0x3b)");
+  g_check_parse_match(int_, (HParserBackend)GPOINTER_TO_INT(backend), "+9223372036854775807;", 21, "(s0x7fffffffffffffff u0x3b)");
+  g_check_parse_failed(int_, (HParserBackend)GPOINTER_TO_INT(backend), "9223372036854775808;", 20);
+  g_check_parse_failed(int_, (HParserBackend)GPOINTER_TO_INT(backend), "-;", 2);
+
+  HParseResult *res = h_parse(int_, (const uint8_t*)"-9223372036854775808;", 21);
+  if (!res) {
+    g_test_message("Parse failed on line %d", __LINE__);
+    g_test_fail();
+    return;
+  }
+  g_check_cmp_int64(res->ast->seq->elements[0]->sint, ==, INT64_MIN);
+  h_parse_result_free(res);
+}
+
+static void test_number_unaligned(gconstpointer backend) {
+  // "1234567890;" shifted right by 4 bits
+  const HParser *dec_ = h_sequence(h_bits(4, false), h_decimal_uint(), h_ch(';'), h_bits(4, false), NULL);
+
+  g_check_parse_match(dec_, (HParserBackend)GPOINTER_TO_INT(backend),
+		      "\x03\x13\x23\x33\x43\x53\x63\x73\x83\x93\x03\xb0", 12, "(u0 u0x499602d2 u0x3b u0)");
+}
+
+static void test_varint(gconstpointer backend) {
+  const HParser *u64_ = h_sequence(h_varint_u64(), h_ch(';'), NULL);
+  const HParser *pair_ = h_sequence(h_varint_u64(), h_varint_u64(), h_ch(';'), NULL);
+  const HParser *s64_ = h_sequence(h_varint_s64(), h_ch(';'), NULL);
+
+  g_check_parse_match(u64_, (HParserBackend)GPOINTER_TO_INT(backend), "\x00;", 2, "(u0 u0x3b)");
+  g_check_parse_match(u64_, (HParserBackend)GPOINTER_TO_INT(backend), "\x7f;", 2, "(u0x7f u0x3b)");
+  g_check_parse_match(u64_, (HParserBackend)GPOINTER_TO_INT(backend), "\xac\x02;", 3, "(u0x12c u0x3b)");
+  g_check_parse_match(u64_, (HParserBackend)GPOINTER_TO_INT(backend), "\x81\x80\x80\x80\x80\x80\x80\x01;", 9, "(u0x2000000000001 u0x3b)");
+  g_check_parse_match(u64_, (HParserBackend)GPOINTER_TO_INT(backend), "\xff\xff\xff\xff\xff\xff\xff\x7f;", 9, "(u0xffffffffffffff u0x3b)");
+  g_check_parse_match(u64_, (HParserBackend)GPOINTER_TO_INT(backend), "\xff\xff\xff\xff\xff\xff\xff\xff\xff\x01;", 11, "(u0xffffffffffffffff u0x3b)");
+  g_check_parse_failed(u64_, (HParserBackend)GPOINTER_TO_INT(backend), "\xff\xff\xff\xff\xff\xff\xff\xff\xff\x02;", 11);
+  g_check_parse_failed(u64_, (HParserBackend)GPOINTER_TO_INT(backend), "\x80\x80\x80\x80\x80\x80\x80\x80\x80\x80\x00;", 12);
+  g_check_parse_failed(u64_, (HParserBackend)GPOINTER_TO_INT(backend), "\x80\x80", 2);
+  g_check_parse_match(pair_, (HParserBackend)GPOINTER_TO_INT(backend), "\xac\x02\xff\xff\xff\xff\xff\xff\x7f;", 10, "(u0x12c u0x1ffffffffffff u0x3b)");
+
+  g_check_parse_match(s64_, (HParserBackend)GPOINTER_TO_INT(backend), "\x00;", 2, "(s0 u0x3b)");
+  g_check_parse_match(s64_, (HParserBackend)GPOINTER_TO_INT(backend), "\x01;", 2, "(s-0x1 u0x3b)");
+  g_check_parse_match(s64_, (HParserBackend)GPOINTER_TO_INT(backend), "\x02;", 2, "(s0x1 u0x3b)");
+  g_check_parse_match(s64_, (HParserBackend)GPOINTER_TO_INT(backend), "\x03;", 2, "(s-0x2 u0x3b)");
+  g_check_parse_match(s64_, (HParserBackend)GPOINTER_TO_INT(backend), "\xfe\xff\xff\xff\xff\xff\xff\xff\xff\x01;", 11, "(s0x7fffffffffffffff u0x3b)");
+
+  HParseResult *res = h_parse(s64_, (const uint8_t*)"\xff\xff\xff\xff\xff\xff\xff\xff\xff\x01;", 11);
+  if (!res) {
+    g_test_message("Parse failed on line %d", __LINE__);
+    g_test_fail();
+    return;
+  }
+  g_check_cmp_int64(res->ast->seq->elements[0]->sint, ==, INT64_MIN);
+  h_parse_result_free(res);
+}
+
+static void test_varint_unaligned(gconstpointer backend) {
+  const HParser *u64_ = h_sequence(h_bits(4, false), h_varint_u64(), h_bits(4, false), NULL);
+
+  g_check_parse_match(u64_, (HParserBackend)GPOINTER_TO_INT(backend), "\x0a\xc0\x20", 3, "(u0 u0x12c u0)");
+  g_check_parse_failed(u64_, (HParserBackend)GPOINTER_TO_INT(backend), "\x0a\xc0", 2);
+}
+
+static void test_token_set(gconstpointer backend) {
+  const char *methods[] = {"GET", "GETX", "POST", "PUT", "PATCH", "DELETE", "GET"};
+  const HParser *set_ = h_sequence(h_token_set(methods, 7), h_ch(' '), NULL);
+  const HParser *nocase_ = h_sequence(h_token_set_nocase(methods, 7), h_ch(' '), NULL);
+
+  g_check_parse_match(set_, (HParserBackend)GPOINTER_TO_INT(backend), "GET ", 4, "(<47.45.54> u0x20)");
+  g_check_parse_match(set_, (HParserBackend)GPOINTER_TO_INT(backend), "GETX ", 5, "(<47.45.54.58> u0x20)");
+  g_check_parse_match(set_, (HParserBackend)GPOINTER_TO_INT(backend), "PATCH ", 6, "(<50.41.54.43.48> u0x20)");
+  g_check_parse_failed(set_, (HParserBackend)GPOINTER_TO_INT(backend), "PAT ", 4);
+  g_check_parse_failed(set_, (HParserBackend)GPOINTER_TO_INT(backend), "get ", 4);
+  g_check_parse_match(nocase_, (HParserBackend)GPOINTER_TO_INT(backend), "get ", 4, "(<47.45.54> u0x20)");
+  g_check_parse_match(nocase_, (HParserBackend)GPOINTER_TO_INT(backend), "dElEtE ", 7, "(<44.45.4c.45.54.45> u0x20)");
+  g_check_parse_failed(nocase_, (HParserBackend)GPOINTER_TO_INT(backend), "gex ", 4);
+
+  // packrat commits to the longest word, the others may take a shorter one
+  const char *prefixes[] = {"a", "ab"};
+  HParser *prefix_ = h_sequence(h_token_set(prefixes, 2), h_ch('b'), NULL);
+  switch (GPOINTER_TO_INT(backend)) {
+  case PB_PACKRAT:
+    g_check_parse_failed(prefix_, PB_PACKRAT, "ab", 2);
+    break;
+  case PB_LLk:
+  case PB_LALR:
+    g_check_cmp_int32(h_compile(prefix_, (HParserBackend)GPOINTER_TO_INT(backend), NULL), !=, 0);
+    break;
+  default:
+    g_check_parse_match(prefix_, (HParserBackend)GPOINTER_TO_INT(backend), "ab", 2, "(<61> u0x62)");
+  }
+}
+
+static void test_token_set_unaligned(gconstpointer backend) {
+  const char *methods[] = {"GET", "GETX", "PUT"};
+  const HParser *set_ = h_sequence(h_bits(4, false), h_token_set(methods, 3), h_bits(4, false), NULL);
+
+  g_check_parse_match(set_, (HParserBackend)GPOINTER_TO_INT(backend), "\x04\x74\x55\x40", 4, "(u0 <47.45.54> u0)");
+  g_check_parse_failed(set_, (HParserBackend)GPOINTER_TO_INT(backend), "\x04\x74\x50", 3);
+}
+
+static void test_utf8_span(gconstpointer backend) {
+  const HParser *span_ = h_sequence(h_utf8_span(), h_ch(0xFF), NULL);
+
+  g_check_parse_match(span_, (HParserBackend)GPOINTER_TO_INT(backend), "a\xC3\xA9\xE2\x82\xAC\xF0\x9F\x98\x80\xFF", 11,
+		      "(<61.c3.a9.e2.82.ac.f0.9f.98.80> u0xff)");
+  g_check_parse_match(span_, (HParserBackend)GPOINTER_TO_INT(backend), "\xFF", 1, "(<> u0xff)");
+  g_check_parse_failed(span_, (HParserBackend)GPOINTER_TO_INT(backend), "a\xED\xA0\x80\xFF", 5);
+  g_check_parse_failed(span_, (HParserBackend)GPOINTER_TO_INT(backend), "a\xC3\xFF", 3);
+}
+
+static void test_utf8(gconstpointer backend) {
+  const HParser *utf8_ = h_utf8(h_length_value(h_uint8(), h_uint8()));
+
+  g_check_parse_match(utf8_, (HParserBackend)GPOINTER_TO_INT(backend), "\x03" "a\xC3\xA9", 4, "<03.61.c3.a9>");
+  g_check_parse_failed(utf8_, (HParserBackend)GPOINTER_TO_INT(backend), "\x02" "a\xC3\xA9", 4);
+  g_check_parse_failed(utf8_, (HParserBackend)GPOINTER_TO_INT(backend), "\x02\xC0\x80", 3);
+}
+
+static void test_fields(gconstpointer backend) {
+  HParser *record_ = h_sequence(h_bits(3, false), h_bits(5, true), h_uint16(), h_bits(4, false),
+				h_int8(), h_bits(60, false), h_bits(4, false), NULL);
+  const HParser *shifted_ = h_sequence(h_bits(1, false), record_, NULL);
+  const HParser *header_ = h_sequence(h_uint16(), h_bits(1, false), h_bits(4, false), h_bits(1, false),
+				      h_bits(1, false), h_bits(1, false), h_bits(1, false), h_bits(3, false),
+				      h_bits(4, false), h_uint16(), h_uint16(), h_uint16(), h_uint16(), NULL);
+
+  g_check_parse_match(record_, (HParserBackend)GPOINTER_TO_INT(backend), "\x9a\xbc\xde\xf0\x12\x34\x56\x78\x9a\xbc\xde\xf0\x12", 13,
+		      "(u0x4 s-0x6 u0xbcde u0xf s0x1 u0x23456789abcdef0 u0x1)");
+  g_check_parse_match(shifted_, (HParserBackend)GPOINTER_TO_INT(backend), "\x9a\xbc\xde\xf0\x12\x34\x56\x78\x9a\xbc\xde\xf0\x12", 13,
+		      "(u0x1 (u0x1 s-0xb u0x79bd u0xe s0x2 u0x468acf13579bde0 u0x2))");
+  g_check_parse_failed(record_, (HParserBackend)GPOINTER_TO_INT(backend), "\x9a\xbc\xde\xf0\x12\x34\x56\x78\x9a\xbc\xde\xf0", 12);
+  g_check_parse_match(header_, (HParserBackend)GPOINTER_TO_INT(backend), "\x12\x34\x81\x80\x00\x01\x00\x02\x00\x03\x00\x04", 12,
+		      "(u0x1234 u0x1 u0 u0 u0 u0x1 u0x1 u0 u0 u0x1 u0x2 u0x3 u0x4)");
+}
+
+static void test_packed(gconstpointer backend) {
+  const HParser *many_ = h_packed_many(h_uint16());
+  const HParser *signed_ = h_sequence(h_bits(4, false), h_packed_repeat_n(h_int32(), 2), h_bits(4, false), NULL);
+  const HParser *short_ = h_packed_repeat_n(h_uint64(), 2);
+  g_check_cmp_int32(h_compile((HParser *)many_, (HParserBackend)GPOINTER_TO_INT(backend), NULL), ==, 0);
+  g_check_cmp_int32(h_compile((HParser *)signed_, (HParserBackend)GPOINTER_TO_INT(backend), NULL), ==, 0);
+  g_check_cmp_int32(h_compile((HParser *)short_, (HParserBackend)GPOINTER_TO_INT(backend), NULL), ==, 0);
+  g_check_cmp_int32(h_packed_many(h_ch('a')) == NULL, ==, 1);
+  g_check_cmp_int32(h_packed_repeat_n(h_bits(12, false), 2) == NULL, ==, 1);
+
+  HParseResult *res = h_parse(many_, (const uint8_t*)"\x01\x02\x03\x04\x05", 5);
+  if (!res) {
+    g_test_message("Parse failed on line %d", __LINE__);
+    g_test_fail();
+    return;
+  }
+  const HPackedArray *arr = res->ast->user;
+  g_check_cmp_uint64(arr->len, ==, 2);
+  g_check_cmp_int32(arr->width, ==, 2);
+  g_check_cmp_uint64(((const uint16_t*)arr->elements)[0], ==, 0x0102);
+  g_check_cmp_uint64(((const uint16_t*)arr->elements)[1], ==, 0x0304);
+  h_parse_result_free(res);
+
+  res = h_parse(signed_, (const uint8_t*)"\xff\xff\xff\xfe\x00\x00\x00\x01\x23", 9);
+  if (!res) {
+    g_test_message("Parse failed on line %d", __LINE__);
+    g_test_fail();
+    return;
+  }
+  arr = res->ast->seq->elements[1]->user;
+  g_check_cmp_uint64(arr->len, ==, 2);
+  g_check_cmp_int32(arr->signedp, ==, 1);
+  g_check_cmp_int32(((const int32_t*)arr->elements)[0], ==, -0x20);
+  g_check_cmp_int32(((const int32_t*)arr->elements)[1], ==, 0x12);
+  g_check_cmp_uint64(res->ast->seq->elements[2]->uint, ==, 0x3);
+  h_parse_result_free(res);
+
+  g_check_failed(h_parse(short_, (const uint8_t*)"\x01\x02\x03\x04\x05\x06\x07\x08\x09", 9));
+}
+
+static void test_until(gconstpointer backend) {
+  HParser *crlf = h_token((const uint8_t*)"\r\n", 2);
+  HParser *line = h_until((const uint8_t*)"\r\n", 2);
+  const HParser *until_ = h_sequence(line, crlf, line, crlf, NULL);
+
+  g_check_parse_match(until_, (HParserBackend)GPOINTER_TO_INT(backend), "GET /\r\nHost\r\n", 14, "(<47.45.54.20.2f> <0d.0a> <48.6f.73.74> <0d.0a>)");
+  g_check_parse_match(until_, (HParserBackend)GPOINTER_TO_INT(backend), "a\rb\r\n\r\n", 8, "(<61.0d.62> <0d.0a> <> <0d.0a>)");
+  g_check_parse_failed(until_, (HParserBackend)GPOINTER_TO_INT(backend), "GET /\r\nHost\r", 13);
+}
+
+static void test_length_window(gconstpointer backend) {
+  const HParser *u16 = h_sequence(h_uint16(), h_end_p(), NULL);
+  const HParser *window_ = h_sequence(h_uint8(), h_length_window(h_uint8(), u16), h_ch('z'), NULL);
+  const HParser *raw_ = h_length_window(h_uint8(), NULL);
+  const HParser *wide_ = h_length_window(h_uint8(), h_uint32());
+  const HParser *signed_ = h_length_value(h_int8(), h_uint8());
+
+  g_check_parse_match(window_, (HParserBackend)GPOINTER_TO_INT(backend), "\x01\x02\xab\xcdz", 5, "(u0x1 (u0xabcd) u0x7a)");
+  g_check_parse_match(window_, (HParserBackend)GPOINTER_TO_INT(backend), "\x01\x03\xab\xcd\xefz", 6, "(u0x1 <ab.cd.ef> u0x7a)");
+  g_check_parse_failed(window_, (HParserBackend)GPOINTER_TO_INT(backend), "\x01\x09\xab\xcdz", 5);
+  g_check_parse_match(raw_, (HParserBackend)GPOINTER_TO_INT(backend), "\x02" "ab", 3, "<61.62>");
+  g_check_parse_match(wide_, (HParserBackend)GPOINTER_TO_INT(backend), "\x02" "abcd", 5, "<61.62>");
+  g_check_parse_failed(signed_, (HParserBackend)GPOINTER_TO_INT(backend), "\x01a", 2);
+}
+
 static void test_sepBy(gconstpointer backend) {
   const HParser *sepBy_ = h_sepBy(h_choice(h_ch('1'), h_ch('2'), h_ch('3'), NULL), h_ch(','));
 
@@ -441,6 +706,218 @@ static void test_ambiguous(gconstpointer backend) {
   g_check_parse_match(expr_, (HParserBackend)GPOINTER_TO_INT(backend), "d+d", 3, "(u0x64 u0x2b u0x64)");
   g_check_parse_match(expr_, (HParserBackend)GPOINTER_TO_INT(backend), "d+d+d", 5, "(u0x64 u0x2b u0x64 u0x2b u0x64)");
   g_check_parse_failed(expr_, (HParserBackend)GPOINTER_TO_INT(backend), "d+", 2);
+
+  // exponentially many derivations, but a polynomial-size parse forest
+  g_check_parse_match(expr_, (HParserBackend)GPOINTER_TO_INT(backend),
+                      "d+d+d+d+d+d+d+d+d+d+d+d+d+d+d+d+d+d+d+d+d+d+d+d+d", 49,
+                      "(u0x64 u0x2b u0x64 u0x2b u0x64 u0x2b u0x64 u0x2b u0x64 u0x2b"
+                      " u0x64 u0x2b u0x64 u0x2b u0x64 u0x2b u0x64 u0x2b u0x64 u0x2b"
+                      " u0x64 u0x2b u0x64 u0x2b u0x64 u0x2b u0x64 u0x2b u0x64 u0x2b"
+                      " u0x64 u0x2b u0x64 u0x2b u0x64 u0x2b u0x64 u0x2b u0x64 u0x2b"
+                      " u0x64 u0x2b u0x64 u0x2b u0x64 u0x2b u0x64 u0x2b u0x64)");
+}
+
+static void test_precedence(gconstpointer backend) {
+  HParserBackend be = (HParserBackend)GPOINTER_TO_INT(backend);
+  HParser *E_ = h_indirect();
+  h_bind_indirect(E_, h_choice(h_nonassoc(h_sequence(E_, h_ch('<'), E_, NULL), 1),
+			       h_left_assoc(h_sequence(E_, h_ch('+'), E_, NULL), 2),
+			       h_sequence(E_, h_left_assoc(h_ch('*'), 3), E_, NULL),
+			       h_sequence(E_, h_right_assoc(h_ch('^'), 4), E_, NULL),
+			       h_ch('d'),
+			       NULL));
+
+  g_check_cmp_int32(h_compile(E_, PB_LALR, NULL), ==, 0);
+  g_check_parse_match(E_, be, "d+d*d", 5, "(u0x64 u0x2b (u0x64 u0x2a u0x64))");
+  g_check_parse_match(E_, be, "d*d+d", 5, "((u0x64 u0x2a u0x64) u0x2b u0x64)");
+  g_check_parse_match(E_, be, "d+d+d", 5, "((u0x64 u0x2b u0x64) u0x2b u0x64)");
+  g_check_parse_match(E_, be, "d^d^d", 5, "(u0x64 u0x5e (u0x64 u0x5e u0x64))");
+  g_check_parse_match(E_, be, "d+d<d*d", 7,
+		      "((u0x64 u0x2b u0x64) u0x3c (u0x64 u0x2a u0x64))");
+  g_check_parse_failed(h_sequence(E_, h_end_p(), NULL), be, "d<d<d", 5);
+}
+
+static HParsedToken* count_action(const HParseResult *p, void* user_data) {
+  (*(int*)user_data)++;
+  return (HParsedToken*)p->ast;
+}
+
+static void test_deferred_actions(gconstpointer backend) {
+  int count = 0;
+  HParser *a1_ = h_action(h_ch('a'), count_action, &count);
+  HParser *a2_ = h_action(h_ch('a'), count_action, &count);
+  HParser *p_ = h_choice(h_sequence(a1_, h_ch('b'), NULL),
+			 h_sequence(a2_, h_ch('c'), NULL),
+			 NULL);
+  HPackratParams params = { .defer_actions = true };
+
+  // the action on the abandoned alternative never runs
+  g_check_cmp_int32(h_compile(p_, PB_PACKRAT, &params), ==, 0);
+  HParseResult *res = h_parse(p_, (const uint8_t*)"ac", 2);
+  g_check_cmp_int32(count, ==, 1);
+  if (res) {
+    char* cres = h_write_result_unamb(res->ast);
+    g_check_string(cres, ==, "(u0x61 u0x63)");
+    free(cres);
+    h_parse_result_free(res);
+  } else {
+    g_test_message("Parse failed on line %d", __LINE__);
+    g_test_fail();
+  }
+
+  // actions below a validation are forced for it
+  HParser *ab_ = h_attr_bool(h_many1(h_action(h_choice(h_ch('a'), h_ch('b'), NULL),
+					      count_action, &count)),
+			     validate_test_ab, NULL);
+  g_check_cmp_int32(h_compile(ab_, PB_PACKRAT, &params), ==, 0);
+  count = 0;
+  res = h_parse(ab_, (const uint8_t*)"aa", 2);
+  g_check_cmp_int32(count, ==, 2);
+  if (!res) {
+    g_test_message("Parse failed on line %d", __LINE__);
+    g_test_fail();
+  }
+  h_parse_result_free(res);
+  g_check_failed(h_parse(ab_, (const uint8_t*)"ab", 2));
+}
+
+static void test_lazy(gconstpointer backend) {
+  int count = 0;
+  HParser *u16_ = h_action(h_uint16(), count_action, &count);
+  HParser *p_ = h_sequence(h_length_window(h_uint8(), h_lazy(u16_)),
+			   h_lazy(h_many1(h_ch('a'))),
+			   NULL);
+
+  // nothing is parsed until it is forced, and then only once
+  g_check_cmp_int32(h_compile(p_, PB_PACKRAT, NULL), ==, 0);
+  HParseResult *res = h_parse(p_, (const uint8_t*)"\x02\xab\xcd" "aab", 6);
+  g_check_cmp_int32(count, ==, 0);
+  if (!res) {
+    g_test_message("Parse failed on line %d", __LINE__);
+    g_test_fail();
+    return;
+  }
+  const HParsedToken *window = res->ast->seq->elements[0];
+  HParseResult *inner = h_force(window);
+  g_check_cmp_int32(count, ==, 1);
+  g_check_cmp_uint64(inner->ast->uint, ==, 0xabcd);
+  g_check_cmp_int32(inner->arena == res->arena, ==, 1);
+  g_check_cmp_int32(h_force(window) == inner, ==, 1);
+  g_check_cmp_int32(count, ==, 1);
+  char* cres = h_write_result_unamb(h_force(res->ast->seq->elements[1])->ast);
+  g_check_string(cres, ==, "(u0x61 u0x61)");
+  free(cres);
+  h_parse_result_free(res);
+
+  // a failing thunk fails when forced, not before
+  res = h_parse(p_, (const uint8_t*)"\x01\xab" "b", 3);
+  if (!res) {
+    g_test_message("Parse failed on line %d", __LINE__);
+    g_test_fail();
+    return;
+  }
+  g_check_failed(h_force(res->ast->seq->elements[0]));
+  g_check_failed(h_force(res->ast->seq->elements[1]));
+  h_parse_result_free(res);
+
+  // only h_lazy tokens can be forced
+  HParsedToken user = { .token_type = TT_USER };
+  g_check_failed(h_force(&user));
+
+  // thunks defer actions when the parse that made them did
+  HPackratParams params = { .defer_actions = true };
+  g_check_cmp_int32(h_compile(p_, PB_PACKRAT, &params), ==, 0);
+  count = 0;
+  res = h_parse(p_, (const uint8_t*)"\x02\xab\xcd" "aab", 6);
+  if (!res) {
+    g_test_message("Parse failed on line %d", __LINE__);
+    g_test_fail();
+    return;
+  }
+  inner = h_force(res->ast->seq->elements[0]);
+  g_check_cmp_int32(count, ==, 1);
+  g_check_cmp_uint64(inner->ast->uint, ==, 0xabcd);
+  h_parse_result_free(res);
+}
+
+static HParsedToken* act_nested(const HParseResult *p, void* user_data) {
+  HParseResult *res = h_parse_nested(p, (const HParser*)user_data, (const uint8_t*)"ab", 2);
+  return res ? (HParsedToken*)res->ast : NULL;
+}
+
+static void test_parse_nested(gconstpointer backend) {
+  HParser *inner_ = h_sequence(h_ch('a'), h_ch('b'), NULL);
+  HParser *outer_ = h_sequence(h_ch('x'), h_action(h_ch('y'), act_nested, inner_), NULL);
+  if (h_compile(inner_, (HParserBackend)GPOINTER_TO_INT(backend), NULL) ||
+      h_compile(outer_, (HParserBackend)GPOINTER_TO_INT(backend), NULL)) {
+    g_test_message("Backend not applicable, skipping test");
+    return;
+  }
+  HParseResult *res = h_parse(outer_, (const uint8_t*)"xy", 2);
+  if (!res) {
+    g_test_message("Parse failed on line %d", __LINE__);
+    g_test_fail();
+    return;
+  }
+  char* cres = h_write_result_unamb(res->ast);
+  g_check_string(cres, ==, "(u0x78 (u0x61 u0x62))");
+  free(cres);
+
+  // again and again from the same result, which owns what they return
+  for (int i = 0; i < 3; i++) {
+    HParseResult *nested = h_parse_nested(res, inner_, (const uint8_t*)"ab", 2);
+    if (!nested) {
+      g_test_message("Parse failed on line %d", __LINE__);
+      g_test_fail();
+      break;
+    }
+    g_check_cmp_int32(nested->arena == res->arena, ==, 1);
+    cres = h_write_result_unamb(nested->ast);
+    g_check_string(cres, ==, "(u0x61 u0x62)");
+    free(cres);
+    g_check_failed(h_parse_nested(res, inner_, (const uint8_t*)"ba", 2));
+  }
+  h_parse_result_free(res);
+}
+
+static void test_glr_deferred_actions(gconstpointer backend) {
+  int count = 0;
+  HParser *d_ = h_ch('d');
+  HParser *p_ = h_ch('+');
+  HParser *E_ = h_indirect();
+  h_bind_indirect(E_, h_choice(h_action(h_sequence(E_, p_, E_, NULL), count_action, &count),
+			       d_, NULL));
+
+  // of the three sums in the forest, the chosen derivation uses two
+  g_check_parse_ok(E_, (HParserBackend)GPOINTER_TO_INT(backend), "d+d+d", 5);
+  g_check_cmp_int32(count, ==, 2);
+}
+
+static void test_lr1(gconstpointer backend) {
+  // S -> 'a' A 'd' | 'b' B 'd' | 'a' B 'e' | 'b' A 'e',  A -> 'c',  B -> 'c'
+  // is LR(1), but LALR(1) merges the states after "ac" and "bc".
+  HParser *A_ = h_choice(h_ch('c'), NULL);
+  HParser *B_ = h_choice(h_ch('c'), NULL);
+  HParser *S_ = h_choice(h_sequence(h_ch('a'), A_, h_ch('d'), NULL),
+			 h_sequence(h_ch('b'), B_, h_ch('d'), NULL),
+			 h_sequence(h_ch('a'), B_, h_ch('e'), NULL),
+			 h_sequence(h_ch('b'), A_, h_ch('e'), NULL),
+			 NULL);
+  HLRParams params = { .lr1 = true };
+
+  g_check_cmp_int32(h_compile(S_, (HParserBackend)GPOINTER_TO_INT(backend), NULL), ==, -1);
+  g_check_cmp_int32(h_compile(S_, (HParserBackend)GPOINTER_TO_INT(backend), &params), ==, 0);
+  HParseResult *res = h_parse(S_, (const uint8_t*)"bce", 3);
+  if (res) {
+    char* cres = h_write_result_unamb(res->ast);
+    g_check_string(cres, ==, "(u0x62 u0x63 u0x65)");
+    free(cres);
+    h_parse_result_free(res);
+  } else {
+    g_test_message("Parse failed on line %d", __LINE__);
+    g_test_fail();
+  }
+  g_check_failed(h_parse(S_, (const uint8_t*)"acf", 3));
 }
 
 void register_parser_tests(void) {
@@ -475,6 +952,7 @@ void register_parser_tests(void) {
   g_test_add_data_func("/core/parser/packrat/difference", GINT_TO_POINTER(PB_PACKRAT), test_difference);
   g_test_add_data_func("/core/parser/packrat/xor", GINT_TO_POINTER(PB_PACKRAT), test_xor);
   g_test_add_data_func("/core/parser/packrat/many", GINT_TO_POINTER(PB_PACKRAT), test_many);
+  g_test_add_data_func("/core/parser/packrat/many_charset", GINT_TO_POINTER(PB_PACKRAT), test_many_charset);
   g_test_add_data_func("/core/parser/packrat/many1", GINT_TO_POINTER(PB_PACKRAT), test_many1);
   g_test_add_data_func("/core/parser/packrat/repeat_n", GINT_TO_POINTER(PB_PACKRAT), test_repeat_n);
   g_test_add_data_func("/core/parser/packrat/optional", GINT_TO_POINTER(PB_PACKRAT), test_optional);
@@ -485,8 +963,26 @@ void register_parser_tests(void) {
   g_test_add_data_func("/core/parser/packrat/and", GINT_TO_POINTER(PB_PACKRAT), test_and);
   g_test_add_data_func("/core/parser/packrat/not", GINT_TO_POINTER(PB_PACKRAT), test_not);
   g_test_add_data_func("/core/parser/packrat/ignore", GINT_TO_POINTER(PB_PACKRAT), test_ignore);
+  g_test_add_data_func("/core/parser/packrat/capture", GINT_TO_POINTER(PB_PACKRAT), test_capture);
+  g_test_add_data_func("/core/parser/packrat/bytes", GINT_TO_POINTER(PB_PACKRAT), test_bytes);
+  g_test_add_data_func("/core/parser/packrat/bytes_unaligned", GINT_TO_POINTER(PB_PACKRAT), test_bytes_unaligned);
+  g_test_add_data_func("/core/parser/packrat/until", GINT_TO_POINTER(PB_PACKRAT), test_until);
+  g_test_add_data_func("/core/parser/packrat/packed", GINT_TO_POINTER(PB_PACKRAT), test_packed);
+  g_test_add_data_func("/core/parser/packrat/fields", GINT_TO_POINTER(PB_PACKRAT), test_fields);
+  g_test_add_data_func("/core/parser/packrat/length_window", GINT_TO_POINTER(PB_PACKRAT), test_length_window);
+  g_test_add_data_func("/core/parser/packrat/lazy", GINT_TO_POINTER(PB_PACKRAT), test_lazy);
   //g_test_add_data_func("/core/parser/packrat/leftrec", GINT_TO_POINTER(PB_PACKRAT), test_leftrec);
   g_test_add_data_func("/core/parser/packrat/rightrec", GINT_TO_POINTER(PB_PACKRAT), test_rightrec);
+  g_test_add_data_func("/core/parser/packrat/deferred_actions", GINT_TO_POINTER(PB_PACKRAT), test_deferred_actions);
+  g_test_add_data_func("/core/parser/packrat/parse_nested", GINT_TO_POINTER(PB_PACKRAT), test_parse_nested);
+  g_test_add_data_func("/core/parser/packrat/number", GINT_TO_POINTER(PB_PACKRAT), test_number);
+  g_test_add_data_func("/core/parser/packrat/utf8_span", GINT_TO_POINTER(PB_PACKRAT), test_utf8_span);
+  g_test_add_data_func("/core/parser/packrat/varint", GINT_TO_POINTER(PB_PACKRAT), test_varint);
+  g_test_add_data_func("/core/parser/packrat/token_set", GINT_TO_POINTER(PB_PACKRAT), test_token_set);
+  g_test_add_data_func("/core/parser/packrat/token_set_unaligned", GINT_TO_POINTER(PB_PACKRAT), test_token_set_unaligned);
+  g_test_add_data_func("/core/parser/packrat/varint_unaligned", GINT_TO_POINTER(PB_PACKRAT), test_varint_unaligned);
+  g_test_add_data_func("/core/parser/packrat/utf8", GINT_TO_POINTER(PB_PACKRAT), test_utf8);
+  g_test_add_data_func("/core/parser/packrat/number_unaligned", GINT_TO_POINTER(PB_PACKRAT), test_number_unaligned);
 
   g_test_add_data_func("/core/parser/llk/token", GINT_TO_POINTER(PB_LLk), test_token);
   g_test_add_data_func("/core/parser/llk/ch", GINT_TO_POINTER(PB_LLk), test_ch);
@@ -516,6 +1012,7 @@ void register_parser_tests(void) {
   g_test_add_data_func("/core/parser/llk/sequence", GINT_TO_POINTER(PB_LLk), test_sequence);
   g_test_add_data_func("/core/parser/llk/choice", GINT_TO_POINTER(PB_LLk), test_choice);
   g_test_add_data_func("/core/parser/llk/many", GINT_TO_POINTER(PB_LLk), test_many);
+  g_test_add_data_func("/core/parser/llk/many_charset", GINT_TO_POINTER(PB_LLk), test_many_charset);
   g_test_add_data_func("/core/parser/llk/many1", GINT_TO_POINTER(PB_LLk), test_many1);
   g_test_add_data_func("/core/parser/llk/optional", GINT_TO_POINTER(PB_LLk), test_optional);
   g_test_add_data_func("/core/parser/llk/sepBy", GINT_TO_POINTER(PB_LLk), test_sepBy);
@@ -523,8 +1020,15 @@ void register_parser_tests(void) {
   g_test_add_data_func("/core/parser/llk/epsilon_p", GINT_TO_POINTER(PB_LLk), test_epsilon_p);
   g_test_add_data_func("/core/parser/llk/attr_bool", GINT_TO_POINTER(PB_LLk), test_attr_bool);
   g_test_add_data_func("/core/parser/llk/ignore", GINT_TO_POINTER(PB_LLk), test_ignore);
+  g_test_add_data_func("/core/parser/llk/capture", GINT_TO_POINTER(PB_LLk), test_capture);
+  g_test_add_data_func("/core/parser/llk/bytes", GINT_TO_POINTER(PB_LLk), test_bytes);
   //g_test_add_data_func("/core/parser/llk/leftrec", GINT_TO_POINTER(PB_LLk), test_leftrec);
   g_test_add_data_func("/core/parser/llk/rightrec", GINT_TO_POINTER(PB_LLk), test_rightrec);
+  g_test_add_data_func("/core/parser/llk/parse_nested", GINT_TO_POINTER(PB_LLk), test_parse_nested);
+  g_test_add_data_func("/core/parser/llk/number", GINT_TO_POINTER(PB_LLk), test_number);
+  g_test_add_data_func("/core/parser/llk/utf8_span", GINT_TO_POINTER(PB_LLk), test_utf8_span);
+  g_test_add_data_func("/core/parser/llk/varint", GINT_TO_POINTER(PB_LLk), test_varint);
+  g_test_add_data_func("/core/parser/llk/token_set", GINT_TO_POINTER(PB_LLk), test_token_set);
 
   g_test_add_data_func("/core/parser/regex/token", GINT_TO_POINTER(PB_REGULAR), test_token);
   g_test_add_data_func("/core/parser/regex/ch", GINT_TO_POINTER(PB_REGULAR), test_ch);
@@ -554,6 +1058,7 @@ void register_parser_tests(void) {
   g_test_add_data_func("/core/parser/regex/sequence", GINT_TO_POINTER(PB_REGULAR), test_sequence);
   g_test_add_data_func("/core/parser/regex/choice", GINT_TO_POINTER(PB_REGULAR), test_choice);
   g_test_add_data_func("/core/parser/regex/many", GINT_TO_POINTER(PB_REGULAR), test_many);
+  g_test_add_data_func("/core/parser/regex/many_charset", GINT_TO_POINTER(PB_REGULAR), test_many_charset);
   g_test_add_data_func("/core/parser/regex/many1", GINT_TO_POINTER(PB_REGULAR), test_many1);
   g_test_add_data_func("/core/parser/regex/repeat_n", GINT_TO_POINTER(PB_REGULAR), test_repeat_n);
   g_test_add_data_func("/core/parser/regex/optional", GINT_TO_POINTER(PB_REGULAR), test_optional);
@@ -562,6 +1067,14 @@ void register_parser_tests(void) {
   g_test_add_data_func("/core/parser/regex/epsilon_p", GINT_TO_POINTER(PB_REGULAR), test_epsilon_p);
   g_test_add_data_func("/core/parser/regex/attr_bool", GINT_TO_POINTER(PB_REGULAR), test_attr_bool);
   g_test_add_data_func("/core/parser/regex/ignore", GINT_TO_POINTER(PB_REGULAR), test_ignore);
+  g_test_add_data_func("/core/parser/regex/capture", GINT_TO_POINTER(PB_REGULAR), test_capture);
+  g_test_add_data_func("/core/parser/regex/bytes", GINT_TO_POINTER(PB_REGULAR), test_bytes);
+  g_test_add_data_func("/core/parser/regex/bytes_too_long", GINT_TO_POINTER(PB_REGULAR), test_bytes_too_long);
+  g_test_add_data_func("/core/parser/regex/parse_nested", GINT_TO_POINTER(PB_REGULAR), test_parse_nested);
+  g_test_add_data_func("/core/parser/regex/number", GINT_TO_POINTER(PB_REGULAR), test_number);
+  g_test_add_data_func("/core/parser/regex/utf8_span", GINT_TO_POINTER(PB_REGULAR), test_utf8_span);
+  g_test_add_data_func("/core/parser/regex/varint", GINT_TO_POINTER(PB_REGULAR), test_varint);
+  g_test_add_data_func("/core/parser/regex/token_set", GINT_TO_POINTER(PB_REGULAR), test_token_set);
 
   g_test_add_data_func("/core/parser/lalr/token", GINT_TO_POINTER(PB_LALR), test_token);
   g_test_add_data_func("/core/parser/lalr/ch", GINT_TO_POINTER(PB_LALR), test_ch);
@@ -591,6 +1104,7 @@ void register_parser_tests(void) {
   g_test_add_data_func("/core/parser/lalr/sequence", GINT_TO_POINTER(PB_LALR), test_sequence);
   g_test_add_data_func("/core/parser/lalr/choice", GINT_TO_POINTER(PB_LALR), test_choice);
   g_test_add_data_func("/core/parser/lalr/many", GINT_TO_POINTER(PB_LALR), test_many);
+  g_test_add_data_func("/core/parser/lalr/many_charset", GINT_TO_POINTER(PB_LALR), test_many_charset);
   g_test_add_data_func("/core/parser/lalr/many1", GINT_TO_POINTER(PB_LALR), test_many1);
   g_test_add_data_func("/core/parser/lalr/optional", GINT_TO_POINTER(PB_LALR), test_optional);
   g_test_add_data_func("/core/parser/lalr/sepBy", GINT_TO_POINTER(PB_LALR), test_sepBy);
@@ -598,8 +1112,17 @@ void register_parser_tests(void) {
   g_test_add_data_func("/core/parser/lalr/epsilon_p", GINT_TO_POINTER(PB_LALR), test_epsilon_p);
   g_test_add_data_func("/core/parser/lalr/attr_bool", GINT_TO_POINTER(PB_LALR), test_attr_bool);
   g_test_add_data_func("/core/parser/lalr/ignore", GINT_TO_POINTER(PB_LALR), test_ignore);
+  g_test_add_data_func("/core/parser/lalr/capture", GINT_TO_POINTER(PB_LALR), test_capture);
+  g_test_add_data_func("/core/parser/lalr/bytes", GINT_TO_POINTER(PB_LALR), test_bytes);
   g_test_add_data_func("/core/parser/lalr/leftrec", GINT_TO_POINTER(PB_LALR), test_leftrec);
   g_test_add_data_func("/core/parser/lalr/rightrec", GINT_TO_POINTER(PB_LALR), test_rightrec);
+  g_test_add_data_func("/core/parser/lalr/lr1", GINT_TO_POINTER(PB_LALR), test_lr1);
+  g_test_add_data_func("/core/parser/lalr/precedence", GINT_TO_POINTER(PB_LALR), test_precedence);
+  g_test_add_data_func("/core/parser/lalr/parse_nested", GINT_TO_POINTER(PB_LALR), test_parse_nested);
+  g_test_add_data_func("/core/parser/lalr/number", GINT_TO_POINTER(PB_LALR), test_number);
+  g_test_add_data_func("/core/parser/lalr/utf8_span", GINT_TO_POINTER(PB_LALR), test_utf8_span);
+  g_test_add_data_func("/core/parser/lalr/varint", GINT_TO_POINTER(PB_LALR), test_varint);
+  g_test_add_data_func("/core/parser/lalr/token_set", GINT_TO_POINTER(PB_LALR), test_token_set);
 
   g_test_add_data_func("/core/parser/glr/token", GINT_TO_POINTER(PB_GLR), test_token);
   g_test_add_data_func("/core/parser/glr/ch", GINT_TO_POINTER(PB_GLR), test_ch);
@@ -629,6 +1152,7 @@ void register_parser_tests(void) {
   g_test_add_data_func("/core/parser/glr/sequence", GINT_TO_POINTER(PB_GLR), test_sequence);
   g_test_add_data_func("/core/parser/glr/choice", GINT_TO_POINTER(PB_GLR), test_choice);
   g_test_add_data_func("/core/parser/glr/many", GINT_TO_POINTER(PB_GLR), test_many);
+  g_test_add_data_func("/core/parser/glr/many_charset", GINT_TO_POINTER(PB_GLR), test_many_charset);
   g_test_add_data_func("/core/parser/glr/many1", GINT_TO_POINTER(PB_GLR), test_many1);
   g_test_add_data_func("/core/parser/glr/optional", GINT_TO_POINTER(PB_GLR), test_optional);
   g_test_add_data_func("/core/parser/glr/sepBy", GINT_TO_POINTER(PB_GLR), test_sepBy);
@@ -636,7 +1160,16 @@ void register_parser_tests(void) {
   g_test_add_data_func("/core/parser/glr/epsilon_p", GINT_TO_POINTER(PB_GLR), test_epsilon_p);
   g_test_add_data_func("/core/parser/glr/attr_bool", GINT_TO_POINTER(PB_GLR), test_attr_bool);
   g_test_add_data_func("/core/parser/glr/ignore", GINT_TO_POINTER(PB_GLR), test_ignore);
+  g_test_add_data_func("/core/parser/glr/capture", GINT_TO_POINTER(PB_GLR), test_capture);
+  g_test_add_data_func("/core/parser/glr/bytes", GINT_TO_POINTER(PB_GLR), test_bytes);
   g_test_add_data_func("/core/parser/glr/leftrec", GINT_TO_POINTER(PB_GLR), test_leftrec);
   g_test_add_data_func("/core/parser/glr/rightrec", GINT_TO_POINTER(PB_GLR), test_rightrec);
   g_test_add_data_func("/core/parser/glr/ambiguous", GINT_TO_POINTER(PB_GLR), test_ambiguous);
+  g_test_add_data_func("/core/parser/glr/precedence", GINT_TO_POINTER(PB_GLR), test_precedence);
+  g_test_add_data_func("/core/parser/glr/deferred_actions", GINT_TO_POINTER(PB_GLR), test_glr_deferred_actions);
+  g_test_add_data_func("/core/parser/glr/parse_nested", GINT_TO_POINTER(PB_GLR), test_parse_nested);
+  g_test_add_data_func("/core/parser/glr/number", GINT_TO_POINTER(PB_GLR), test_number);
+  g_test_add_data_func("/core/parser/glr/utf8_span", GINT_TO_POINTER(PB_GLR), test_utf8_span);
+  g_test_add_data_func("/core/parser/glr/varint", GINT_TO_POINTER(PB_GLR), test_varint);
+  g_test_add_data_func("/core/parser/glr/token_set", GINT_TO_POINTER(PB_GLR), test_token_set);
 }
@@ -20,6 +20,10 @@
 #include <stdint.h>
 #include <stdlib.h>
 #include <inttypes.h>
+#include <time.h>
+
+// The clock h_benchmark times with, for the timing tests in t_benchmark.c.
+void h_benchmark_clock_gettime(struct timespec *ts);
 
 // Equivalent to g_assert_*, but not using g_assert...
 #define g_check_inttype(fmt, typ, n1, op, n2) do {				\